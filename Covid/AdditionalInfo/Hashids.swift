@@ -35,22 +35,41 @@ final class Hashids {
         cHashids = hashids_init3(salt.cString(using: .ascii), minHashLength, alphabet.cString(using: .ascii))
     }
 
+    deinit {
+        hashids_free(cHashids)
+    }
+
     func encode(_ value: Int) -> String? {
-        encodeMany([value])
+        var number = UInt64(value)
+        return encode(&number, count: 1)
     }
 
     func encodeMany(_ values: [Int]) -> String? {
-        let count = values.count
-        let vals = UnsafeMutablePointer<UInt64>.allocate(capacity: count)// [UInt64](repeating: UInt64(0), count: Int(count))
-        for i in 0..<Int(count) {
-            let value = UInt64(values[i])
-            vals[i] = value
-        }
-        let estimation = hashids_estimate_encoded_size(cHashids, count, vals)
-        let buffer = UnsafeMutablePointer<Int8>.allocate(capacity: estimation)//[Int8](repeating: 0, count: estimation)
-        if hashids_encode(cHashids, buffer, count, vals) > 0 {
-            return String(cString: buffer, encoding: .ascii)
+        encode(values.map { UInt64($0) }, count: values.count)
+    }
+
+    private func encode(_ numbers: UnsafePointer<UInt64>, count: Int) -> String? {
+        guard cHashids != nil, count > 0 else { return nil }
+        var context = hashids_ctx_t()
+        var length = 0
+        let estimation = hashids_estimate_encoded_size(cHashids, count, numbers)
+        let buffer = UnsafeMutablePointer<Int8>.allocate(capacity: estimation)
+        defer { buffer.deallocate() }
+        guard hashids_encode_s(cHashids, &context, buffer, count, numbers, &length) == HASHIDS_ERROR_OK else { return nil }
+        return String(cString: buffer)
+    }
+
+    func encodeBatch(_ values: [Int]) -> [String] {
+        guard let cHashids = cHashids, !values.isEmpty else { return [] }
+        let numbers = values.map { UInt64($0) }
+        var offsets = [Int](repeating: 0, count: numbers.count)
+        var lengths = [Int](repeating: 0, count: numbers.count)
+        var context = hashids_ctx_t()
+        let capacity = numbers.count * hashids_estimate_encoded_size(cHashids, 1, [UInt64.max])
+        var arena = [Int8](repeating: 0, count: capacity)
+        let encoded = hashids_encode_batch(cHashids, &context, &arena, capacity, numbers.count, nil, numbers, &offsets, &lengths)
+        return arena.withUnsafeBufferPointer { arena in
+            (0..<encoded).map { String(cString: arena.baseAddress! + offsets[$0]) }
         }
-        return nil
     }
 }
@@ -3,6 +3,9 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <math.h>
+#ifdef HASHIDS_ENABLE_STATS
+#   include <time.h>
+#endif
 
 #include "hashids.h"
 
@@ -28,9 +31,190 @@
 #   define ATTRIBUTE_FALLTHROUGH
 #endif
 
-/* thread-local storage */
+/* vector classification kernels */
+#if !defined(HASHIDS_NO_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#   if defined(__x86_64__) || defined(__i386__)
+#       include <immintrin.h>
+#       define HASHIDS_HAVE_X86_SIMD 1
+#   elif defined(__aarch64__)
+#       include <arm_neon.h>
+#       define HASHIDS_HAVE_NEON 1
+#   endif
+#endif
+
+/* count trailing zeros (x != 0) */
+#if defined(__GNUC__) || defined(__clang__)
+#   define hashids_ctz64(x) ((size_t)__builtin_ctzll(x))
+#else
+static inline size_t
+hashids_ctz64(unsigned long long x)
+{
+    size_t n;
+
+    for (n = 0; !(x & 1); x >>= 1, ++n) {
+        /* empty */
+    }
+    return n;
+}
+#endif
+
+/* population count */
+#if defined(__GNUC__) || defined(__clang__)
+#   define hashids_popcount64(x) ((size_t)__builtin_popcountll(x))
+#else
+static inline size_t
+hashids_popcount64(unsigned long long x)
+{
+    size_t n;
+
+    for (n = 0; x; x &= x - 1, ++n) {
+        /* empty */
+    }
+    return n;
+}
+#endif
+
+/* thread-local storage (define TLS empty to opt out) */
 #ifndef TLS
-#define TLS
+#   if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#       define TLS _Thread_local
+#   elif defined(__GNUC__) || defined(__clang__)
+#       define TLS __thread
+#   elif defined(_MSC_VER)
+#       define TLS __declspec(thread)
+#   else
+#       define TLS
+#   endif
+#endif
+
+/* decode cache shard locks (define HASHIDS_NO_THREADS to opt out) */
+#if defined(HASHIDS_NO_THREADS)
+typedef int hashids_lock_t;
+#   define hashids_lock_init(l) ((void)(l))
+#   define hashids_lock_destroy(l) ((void)(l))
+#   define hashids_lock(l) ((void)(l))
+#   define hashids_unlock(l) ((void)(l))
+#elif defined(_WIN32)
+#   include <windows.h>
+typedef SRWLOCK hashids_lock_t;
+#   define hashids_lock_init(l) InitializeSRWLock(l)
+#   define hashids_lock_destroy(l) ((void)(l))
+#   define hashids_lock(l) AcquireSRWLockExclusive(l)
+#   define hashids_unlock(l) ReleaseSRWLockExclusive(l)
+#else
+#   include <pthread.h>
+typedef pthread_mutex_t hashids_lock_t;
+#   define hashids_lock_init(l) pthread_mutex_init(l, NULL)
+#   define hashids_lock_destroy(l) pthread_mutex_destroy(l)
+#   define hashids_lock(l) pthread_mutex_lock(l)
+#   define hashids_unlock(l) pthread_mutex_unlock(l)
+#endif
+
+/* instrumentation hooks (HASHIDS_ENABLE_STATS; nothing otherwise) */
+#ifdef HASHIDS_ENABLE_STATS
+/* relaxed atomics (add returns the previous value) */
+#   if defined(__GNUC__) || defined(__clang__)
+#       define hashids_atomic_add(p, v) \
+            __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+#       define hashids_atomic_load(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#       define hashids_atomic_store(p, v) \
+            __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#   elif defined(_MSC_VER)
+#       include <intrin.h>
+#       define hashids_atomic_add(p, v) \
+            ((unsigned long long)_InterlockedExchangeAdd64( \
+            (volatile __int64 *)(p), (__int64)(v)))
+#       define hashids_atomic_load(p) (*(volatile unsigned long long *)(p))
+#       define hashids_atomic_store(p, v) \
+            (*(volatile unsigned long long *)(p) = (v))
+#   else
+#       define hashids_atomic_add(p, v) ((*(p) += (v)) - (v))
+#       define hashids_atomic_load(p) (*(p))
+#       define hashids_atomic_store(p, v) (*(p) = (v))
+#   endif
+
+/* one thread's counters, alone on their cache lines */
+struct hashids_stats_slot_s {
+    hashids_stats_t stats;
+} HASHIDS_ALIGNED(HASHIDS_CACHE_LINE);
+
+/* coarse timestamp */
+static inline unsigned long long
+hashids_ticks(void)
+{
+#   if (defined(__GNUC__) || defined(__clang__)) \
+        && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#   elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#   elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+    unsigned long long ticks;
+
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#   else
+    return (unsigned long long)clock();
+#   endif
+}
+
+/* threads number themselves on first use; the number picks the slot */
+static unsigned long long hashids_stats_threads;
+static TLS unsigned long long hashids_stats_thread;
+
+static inline hashids_stats_t *
+hashids_stats_local(const hashids_t *hashids)
+{
+    if (HASHIDS_UNLIKELY(!hashids_stats_thread)) {
+        hashids_stats_thread = hashids_atomic_add(&hashids_stats_threads,
+            1ull) + 1;
+    }
+
+    return &hashids->stats[(hashids_stats_thread - 1)
+        % HASHIDS_STATS_SLOTS].stats;
+}
+
+/* count one finished operation */
+static void
+hashids_stats_record(const hashids_t *hashids, int op,
+    unsigned long long start, size_t bytes, int status)
+{
+    hashids_stats_t *stats;
+    unsigned long long ticks;
+    size_t bucket;
+
+    ticks = hashids_ticks() - start;
+    for (bucket = 0; ticks >= 4 && bucket < HASHIDS_STATS_BUCKETS - 1;
+        ticks >>= 2) {
+        ++bucket;
+    }
+
+    stats = hashids_stats_local(hashids);
+    hashids_atomic_add(&stats->calls[op], 1ull);
+    hashids_atomic_add(&stats->bytes[op], (unsigned long long)bytes);
+    hashids_atomic_add(&stats->ticks[op][bucket], 1ull);
+    if (status < 0 && -status < HASHIDS_STATS_ERRORS) {
+        hashids_atomic_add(&stats->errors[-status], 1ull);
+    }
+}
+
+#   define HASHIDS_STATS_TIMER(t) unsigned long long t = hashids_ticks()
+#   define HASHIDS_STATS_RESTART(t) ((t) = hashids_ticks())
+#   define HASHIDS_STATS_RECORD(h, op, t, bytes, status) \
+        hashids_stats_record((h), (op), (t), (bytes), (status))
+#   define HASHIDS_STATS_ADD(h, counter, n) \
+        ((void)hashids_atomic_add(&hashids_stats_local(h)->counter, \
+        (unsigned long long)(n)))
+
+/* the slots follow the instance in its block */
+#   define HASHIDS_INSTANCE_SIZE (sizeof(hashids_t) \
+        + HASHIDS_STATS_SLOTS * sizeof(struct hashids_stats_slot_s))
+#else
+#   define HASHIDS_STATS_TIMER(t) (void)0
+#   define HASHIDS_STATS_RESTART(t) ((void)0)
+#   define HASHIDS_STATS_RECORD(h, op, t, bytes, status) ((void)0)
+#   define HASHIDS_STATS_ADD(h, counter, n) ((void)0)
+
+#   define HASHIDS_INSTANCE_SIZE sizeof(hashids_t)
 #endif
 
 /* thread-safe hashids_errno indirection */
@@ -58,6 +242,107 @@ hashids_free_f(void *ptr)
 void *(*_hashids_alloc)(size_t size) = hashids_alloc_f;
 void (*_hashids_free)(void *ptr) = hashids_free_f;
 
+/* default allocator: the global hooks, no context */
+static void *
+hashids_default_alloc(void *user_data, size_t size)
+{
+    (void)user_data;
+    return _hashids_alloc(size);
+}
+
+static void
+hashids_default_free(void *user_data, void *ptr)
+{
+    (void)user_data;
+    _hashids_free(ptr);
+}
+
+const hashids_allocator_t hashids_default_allocator = {
+    hashids_default_alloc,
+    hashids_default_free,
+    NULL
+};
+
+/* instance allocation shortcuts */
+static inline void *
+hashids_instance_alloc(const hashids_t *hashids, size_t size)
+{
+    return hashids->allocator.alloc(hashids->allocator.user_data, size);
+}
+
+static inline void
+hashids_instance_free(const hashids_t *hashids, void *ptr)
+{
+    hashids->allocator.free(hashids->allocator.user_data, ptr);
+}
+
+/* arena alloc(): zeroed, aligned, NULL once exhausted */
+static void *
+hashids_arena_alloc(void *user_data, size_t size)
+{
+    hashids_arena_t *arena;
+    size_t offset;
+
+    arena = (hashids_arena_t *)user_data;
+    offset = (arena->used + HASHIDS_ARENA_ALIGNMENT - 1)
+        & ~(size_t)(HASHIDS_ARENA_ALIGNMENT - 1);
+    if (HASHIDS_UNLIKELY(offset > arena->size
+        || size > arena->size - offset)) {
+        return NULL;
+    }
+
+    arena->last = arena->used;
+    arena->used = offset + size;
+    memset(arena->buffer + offset, 0, size);
+
+    return arena->buffer + offset;
+}
+
+/* arena free(): only the most recent block can be given back */
+static void
+hashids_arena_free(void *user_data, void *ptr)
+{
+    hashids_arena_t *arena;
+
+    arena = (hashids_arena_t *)user_data;
+    if (ptr && arena->used > arena->last && (char *)ptr
+        == arena->buffer + ((arena->last + HASHIDS_ARENA_ALIGNMENT - 1)
+        & ~(size_t)(HASHIDS_ARENA_ALIGNMENT - 1))) {
+        arena->used = arena->last;
+    }
+}
+
+/* set up an arena over buffer (buffer should be suitably aligned) */
+void
+hashids_arena_init(hashids_arena_t *arena, void *buffer, size_t size)
+{
+    arena->buffer = (char *)buffer;
+    arena->size = size;
+    arena->used = 0;
+    arena->last = 0;
+}
+
+/* release everything allocated from the arena */
+void
+hashids_arena_reset(hashids_arena_t *arena)
+{
+    arena->used = 0;
+    arena->last = 0;
+}
+
+/* allocator drawing from the arena */
+hashids_allocator_t
+hashids_arena_allocator(hashids_arena_t *arena)
+{
+    hashids_allocator_t allocator;
+
+    allocator.alloc = hashids_arena_alloc;
+    allocator.free = hashids_arena_free;
+    allocator.user_data = arena;
+
+    return allocator;
+}
+
 /* fast ceil(x / y) for size_t arguments */
 static inline size_t
 hashids_div_ceil_size_t(size_t x, size_t y)
@@ -98,6 +383,41 @@ hashids_log2_64(unsigned long long x)
         ((unsigned long long)((x - (x >> 1)) * 0x07EDD5E59A4E28C2)) >> 58];
 }
 
+/* precompute a multiply & shift reciprocal for d >= 2 */
+static inline void
+hashids_divisor_init(struct hashids_divisor_s *divisor, unsigned long long d)
+{
+    unsigned int l;
+
+    divisor->divisor = d;
+
+    /* l = ceil(log2(d)), magic = floor(2^64 * (2^l - d) / d) + 1 */
+    for (l = 0; l < 64 && (1ull << l) < d; ++l) {
+        /* empty */
+    }
+#ifdef HASHIDS_HAVE_INT128
+    divisor->magic = (unsigned long long)((((hashids_uint128_t)((1ull << l)
+        - d)) << 64) / d) + 1;
+#else
+    divisor->magic = 0;
+#endif
+    divisor->shift = l - 1;
+}
+
+/* fast n / d using the precomputed reciprocal */
+static inline unsigned long long
+hashids_divide(const struct hashids_divisor_s *divisor, unsigned long long n)
+{
+#ifdef HASHIDS_HAVE_INT128
+    unsigned long long t;
+
+    t = (unsigned long long)(((hashids_uint128_t)n * divisor->magic) >> 64);
+    return (t + ((n - t) >> 1)) >> divisor->shift;
+#else
+    return n / divisor->divisor;
+#endif
+}
+
 /* shuffle loop step */
 #define hashids_shuffle_step(iter) \
     if (i == 0) { break; }                                      \
@@ -189,238 +509,2615 @@ hashids_shuffle(char *str, size_t str_length, char *salt, size_t salt_length)
     }
 }
 
-/* "destructor" */
-void
-hashids_free(hashids_t *hashids)
+/* permutation rows: fixed-salt shuffles of alphabets up to this long */
+#define HASHIDS_PERMUTE_MAX 64
+
+/* shuffle str in place by a compiled row: str[i] = old str[row[i]] (str
+   must have HASHIDS_PERMUTE_MAX bytes of room; past length the row is the
+   identity) */
+static void
+hashids_permute_scalar(char *str, const unsigned char *row, size_t length)
 {
-    if (hashids) {
-        if (hashids->alphabet) {
-            _hashids_free(hashids->alphabet);
-        }
-        if (hashids->alphabet_copy_1) {
-            _hashids_free(hashids->alphabet_copy_1);
-        }
-        if (hashids->alphabet_copy_2) {
-            _hashids_free(hashids->alphabet_copy_2);
-        }
-        if (hashids->salt) {
-            _hashids_free(hashids->salt);
-        }
-        if (hashids->separators) {
-            _hashids_free(hashids->separators);
-        }
-        if (hashids->guards) {
-            _hashids_free(hashids->guards);
-        }
+    char source[HASHIDS_PERMUTE_MAX];
+    size_t i;
 
-        _hashids_free(hashids);
+    memcpy(source, str, length);
+    for (i = 0; i < length; ++i) {
+        str[i] = source[row[i]];
     }
 }
 
-/* common init */
-hashids_t *
-hashids_init3(const char *salt, size_t min_hash_length, const char *alphabet)
+#ifdef HASHIDS_HAVE_X86_SIMD
+/* 16 bytes per step, one pshufb per 16-byte source chunk */
+__attribute__((target("ssse3")))
+static void
+hashids_permute_ssse3(char *str, const unsigned char *row, size_t length)
 {
-    hashids_t *result;
-    size_t i, j, len;
-    char ch, *p;
-
-    hashids_errno = HASHIDS_ERROR_OK;
+    __m128i source[4], index, bias, step, v;
+    size_t i, k;
 
-    /* allocate the structure */
-    result = (hashids_t *)_hashids_alloc(sizeof(hashids_t));
-    if (HASHIDS_UNLIKELY(!result)) {
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return NULL;
+    for (k = 0; k < 4; ++k) {
+        source[k] = _mm_loadu_si128((const __m128i *)(str + 16 * k));
     }
-
-    /* allocate enough space for the alphabet */
-    len = strlen(alphabet) + 1;
-    result->alphabet = (char *)_hashids_alloc(len);
-
-    /* extract only the unique characters */
-    result->alphabet[0] = '\0';
-    for (i = 0, j = 0; i < len; ++i) {
-        ch = alphabet[i];
-        if (!strchr(result->alphabet, ch)) {
-            result->alphabet[j++] = ch;
+    bias = _mm_set1_epi8(0x70);
+    step = _mm_set1_epi8(16);
+
+    for (i = 0; i < length; i += 16) {
+        index = _mm_loadu_si128((const __m128i *)(row + i));
+        v = _mm_setzero_si128();
+
+        /* indexes outside the chunk saturate past 0x7F: pshufb zeroes */
+        for (k = 0; k < 4; ++k) {
+            v = _mm_or_si128(v, _mm_shuffle_epi8(source[k],
+                _mm_adds_epu8(index, bias)));
+            index = _mm_sub_epi8(index, step);
         }
+        _mm_storeu_si128((__m128i *)(str + i), v);
     }
-    result->alphabet[j] = '\0';
+}
 
-    /* store alphabet length */
-    result->alphabet_length = j;
+/* the whole row at once (vpermb) */
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static void
+hashids_permute_vbmi(char *str, const unsigned char *row, size_t length)
+{
+    (void)length;
+    _mm512_storeu_si512(str, _mm512_permutexvar_epi8(
+        _mm512_loadu_si512(row), _mm512_loadu_si512(str)));
+}
+#endif
 
-    /* check length and whitespace */
-    if (result->alphabet_length < HASHIDS_MIN_ALPHABET_LENGTH) {
-        hashids_free(result);
-        hashids_errno = HASHIDS_ERROR_ALPHABET_LENGTH;
-        return NULL;
-    }
-    if (strchr(result->alphabet, 0x20) || strchr(result->alphabet, 0x09)) {
-        hashids_free(result);
-        hashids_errno = HASHIDS_ERROR_ALPHABET_SPACE;
-        return NULL;
+#ifdef HASHIDS_HAVE_NEON
+/* 16 bytes per step from a 64-byte table (tbl) */
+static void
+hashids_permute_neon(char *str, const unsigned char *row, size_t length)
+{
+    uint8x16x4_t source;
+    size_t i;
+
+    source.val[0] = vld1q_u8((const unsigned char *)str);
+    source.val[1] = vld1q_u8((const unsigned char *)str + 16);
+    source.val[2] = vld1q_u8((const unsigned char *)str + 32);
+    source.val[3] = vld1q_u8((const unsigned char *)str + 48);
+
+    for (i = 0; i < length; i += 16) {
+        vst1q_u8((unsigned char *)str + i,
+            vqtbl4q_u8(source, vld1q_u8(row + i)));
     }
+}
+#endif
 
-    /* copy salt */
-    result->salt_length = salt ? strlen(salt) : 0;
-    result->salt = (char *)_hashids_alloc(result->salt_length + 1);
-    if (HASHIDS_UNLIKELY(!result->salt)) {
-        hashids_free(result);
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return NULL;
+/* pick the permutation kernel for this CPU */
+static int
+hashids_permute_select(void)
+{
+#if defined(HASHIDS_HAVE_X86_SIMD)
+    if (__builtin_cpu_supports("avx512vbmi")) {
+        return HASHIDS_PERMUTE_VBMI;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return HASHIDS_PERMUTE_SSSE3;
     }
-    strncpy(result->salt, salt, result->salt_length);
+#elif defined(HASHIDS_HAVE_NEON)
+    return HASHIDS_PERMUTE_NEON;
+#endif
+    return HASHIDS_PERMUTE_SCALAR;
+}
 
-    /* allocate enough space for separators */
-    len = strlen(HASHIDS_DEFAULT_SEPARATORS);
-    j = (size_t)
-        (ceil((float)result->alphabet_length / HASHIDS_SEPARATOR_DIVISOR) + 1);
-    if (j < len + 1) {
-        j = len + 1;
+/* apply a compiled shuffle with the instance's kernel */
+static inline void
+hashids_permute(const hashids_t *hashids, char *str, const unsigned char *row)
+{
+    switch (hashids->permute_kernel) {
+#ifdef HASHIDS_HAVE_X86_SIMD
+        case HASHIDS_PERMUTE_VBMI:
+            hashids_permute_vbmi(str, row, hashids->alphabet_length);
+            return;
+        case HASHIDS_PERMUTE_SSSE3:
+            hashids_permute_ssse3(str, row, hashids->alphabet_length);
+            return;
+#endif
+#ifdef HASHIDS_HAVE_NEON
+        case HASHIDS_PERMUTE_NEON:
+            hashids_permute_neon(str, row, hashids->alphabet_length);
+            return;
+#endif
+        default:
+            hashids_permute_scalar(str, row, hashids->alphabet_length);
     }
+}
 
-    result->separators = (char *)_hashids_alloc(j);
-    if (HASHIDS_UNLIKELY(!result->separators)) {
-        hashids_free(result);
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return NULL;
+/* build the lottery-independent part of the per-iteration salt */
+static inline int
+hashids_prepare_salt(const hashids_t *hashids, hashids_ctx_t *ctx)
+{
+    int p_max;
+
+    /* alphabet-like buffer used for salt at each iteration */
+    p_max = (int)(hashids->alphabet_length - 1 - hashids->salt_length);
+    if (p_max > 0) {
+        memcpy(ctx->alphabet_copy_2 + 1, hashids->salt, hashids->salt_length);
+    } else {
+        memcpy(ctx->alphabet_copy_2 + 1, hashids->salt,
+            hashids->alphabet_length - 1);
+        ctx->alphabet_copy_2[hashids->alphabet_length] = '\0';
     }
 
-    /* take default separators out of the alphabet */
-    for (i = 0, j = 0; i < strlen(HASHIDS_DEFAULT_SEPARATORS); ++i) {
-        ch = HASHIDS_DEFAULT_SEPARATORS[i];
+    return p_max;
+}
 
-        /* check if separator is actually in the used alphabet */
-        if ((p = strchr(result->alphabet, ch))) {
-            result->separators[j++] = ch;
+/* the alphabet used for the k-th number, from the cache or shuffled */
+static inline const char *
+hashids_next_alphabet(const hashids_t *hashids, hashids_ctx_t *ctx,
+    int p_max, const char *alphabet, const char *cached, size_t k)
+{
+    size_t row;
 
-            /* remove that separator */
-            memmove(p, p + 1,
-                strlen(result->alphabet) - (p - result->alphabet));
-        }
+    if (cached && k < hashids->shuffles_depth) {
+        return cached + k * hashids->alphabet_length;
     }
 
-    /* store separators length */
-    result->separators_count = j;
-
-    /* subtract separators count from alphabet length */
-    result->alphabet_length -= result->separators_count;
+    /* continue from whatever the previous alphabet was */
+    if (alphabet != ctx->alphabet_copy_1) {
+        memcpy(ctx->alphabet_copy_1, alphabet, hashids->alphabet_length);
+    }
+    HASHIDS_STATS_ADD(hashids, shuffles, 1);
+
+    /* a fixed salt (lottery & salt prefix) makes it a compiled row */
+    if (hashids->permutations) {
+        row = hashids->indexes[(unsigned char)ctx->alphabet_copy_2[0]];
+        if (HASHIDS_LIKELY(row != HASHIDS_INDEX_NONE)) {
+            hashids_permute(hashids, ctx->alphabet_copy_1,
+                hashids->permutations + row * HASHIDS_PERMUTE_MAX);
+            return ctx->alphabet_copy_1;
+        }
+    }
 
-    /* shuffle the separators */
-    if (result->separators_count) {
-        hashids_shuffle(result->separators, result->separators_count,
-            result->salt, result->salt_length);
+    /* create a salt for this iteration */
+    if (p_max > 0) {
+        memcpy(ctx->alphabet_copy_2 + hashids->salt_length + 1,
+            ctx->alphabet_copy_1, p_max);
     }
 
-    /* check if we have any/enough separators */
-    if (!result->separators_count
-        || (((float)result->alphabet_length / (float)result->separators_count)
-            > HASHIDS_SEPARATOR_DIVISOR)) {
-        size_t separators_count = (size_t)ceil(
-            (float)result->alphabet_length / HASHIDS_SEPARATOR_DIVISOR);
+    /* shuffle the alphabet */
+    hashids_shuffle(ctx->alphabet_copy_1, hashids->alphabet_length,
+        ctx->alphabet_copy_2, hashids->alphabet_length);
 
-        if (separators_count == 1) {
-            separators_count = 2;
-        }
+    return ctx->alphabet_copy_1;
+}
 
-        if (separators_count > result->separators_count) {
-            /* we need more separators - get some from alphabet */
-            size_t diff = separators_count - result->separators_count;
-            strncat(result->separators, result->alphabet, diff);
-            memmove(result->alphabet, result->alphabet + diff,
-                result->alphabet_length - diff + 1);
+/* digit value of every alphabet byte (by alphabet position) */
+static inline void
+hashids_invert_alphabet(const hashids_t *hashids, const char *alphabet,
+    unsigned char *digits)
+{
+    size_t i;
 
-            result->separators_count += diff;
-            result->alphabet_length -= diff;
-        } else {
-            /* we have more than enough - truncate */
-            result->separators[separators_count] = '\0';
-            result->separators_count = separators_count;
-        }
+    for (i = 0; i < hashids->alphabet_length; ++i) {
+        digits[hashids->indexes[(unsigned char)alphabet[i]]] = (unsigned char)i;
     }
+}
 
-    /* shuffle alphabet */
-    hashids_shuffle(result->alphabet, result->alphabet_length,
-        result->salt, result->salt_length);
+/* the digit table for the k-th number, from the cache or built after the
+   shuffle */
+static inline const unsigned char *
+hashids_next_digits(const hashids_t *hashids, hashids_ctx_t *ctx,
+    int p_max, const char **alphabet, const char *cached,
+    const unsigned char *cached_digits, size_t k)
+{
+    *alphabet = hashids_next_alphabet(hashids, ctx, p_max, *alphabet, cached,
+        k);
 
-    /* allocate guards */
-    result->guards_count = hashids_div_ceil_size_t(result->alphabet_length,
-        HASHIDS_GUARD_DIVISOR);
-    result->guards = (char *)_hashids_alloc(result->guards_count + 1);
-    if (HASHIDS_UNLIKELY(!result->guards)) {
-        hashids_free(result);
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return NULL;
+    if (cached && k < hashids->shuffles_depth) {
+        return cached_digits + k * hashids->alphabet_length;
     }
 
-    if (HASHIDS_UNLIKELY(result->alphabet_length < 3)) {
-        /* take some from separators */
-        strncpy(result->guards, result->separators, result->guards_count);
-        memmove(result->separators, result->separators + result->guards_count,
-            result->separators_count - result->guards_count + 1);
+    hashids_invert_alphabet(hashids, *alphabet, ctx->digits);
+    return ctx->digits;
+}
 
-        result->separators_count -= result->guards_count;
-    } else {
-        /* take them from alphabet */
-        strncpy(result->guards, result->alphabet, result->guards_count);
-        memmove(result->alphabet, result->alphabet + result->guards_count,
-            result->alphabet_length - result->guards_count + 1);
+/* scan block size, one bit per byte */
+#define HASHIDS_SCAN_BLOCK 64
 
-        result->alphabet_length -= result->guards_count;
-    }
+/* mask of the low n bits (n <= 64) */
+#define hashids_low_bits(n) \
+    ((n) >= 64 ? ~0ull : (1ull << (n)) - 1)
 
-    /* allocate enough space for the alphabet copies */
-    result->alphabet_copy_1 = (char *)_hashids_alloc(result->alphabet_length +
-        1);
-    result->alphabet_copy_2 = (char *)_hashids_alloc(result->alphabet_length +
-        1);
-    if (HASHIDS_UNLIKELY(!result->alphabet || !result->alphabet_copy_1
-        || !result->alphabet_copy_2)) {
-        hashids_free(result);
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return NULL;
+/* classify up to 64 bytes into alphabet/separator/guard bit masks */
+static void
+hashids_scan_scalar(const hashids_t *hashids, const char *str, size_t len,
+    unsigned long long masks[3])
+{
+    unsigned long long alphabet, separators, guards;
+    size_t i;
+    unsigned char cls;
+
+    /* locals, as stores through masks could alias the class table */
+    alphabet = separators = guards = 0;
+    for (i = 0; i < len; ++i) {
+        cls = hashids->classes[(unsigned char)str[i]];
+        alphabet |= (unsigned long long)(cls == HASHIDS_CLASS_ALPHABET) << i;
+        separators |= (unsigned long long)(cls == HASHIDS_CLASS_SEPARATOR)
+            << i;
+        guards |= (unsigned long long)(cls == HASHIDS_CLASS_GUARD) << i;
     }
 
-    /* set min hash length */
-    result->min_hash_length = min_hash_length;
-
-    /* return result happily */
-    return result;
+    masks[0] = alphabet;
+    masks[1] = separators;
+    masks[2] = guards;
 }
 
-/* init with salt and minimum hash length */
-hashids_t *
-hashids_init2(const char *salt, size_t min_hash_length)
+/* classify a tail shorter than a vector into masks at bit offset i (a
+   bounce buffer would stall the vector load on store forwarding) */
+static inline void
+hashids_scan_tail(const hashids_t *hashids, const char *str, size_t len,
+    size_t i, unsigned long long masks[3])
 {
-    return hashids_init3(salt, min_hash_length, HASHIDS_DEFAULT_ALPHABET);
+    unsigned long long tail[3];
+    size_t k;
+
+    hashids_scan_scalar(hashids, str + i, len - i, tail);
+    for (k = 0; k < 3; ++k) {
+        masks[k] |= tail[k] << i;
+    }
 }
 
-/* init with hash only */
+#ifdef HASHIDS_HAVE_X86_SIMD
+/* 16 bytes per step: set membership via two nibble lookups (pshufb) */
+__attribute__((target("ssse3")))
+static void
+hashids_scan_ssse3(const hashids_t *hashids, const char *str, size_t len,
+    unsigned long long masks[3])
+{
+    __m128i tables[3], nibble, bits, zero, v, lo, hi, m;
+    size_t i, k;
+
+    for (k = 0; k < 3; ++k) {
+        tables[k] = _mm_loadu_si128((const __m128i *)hashids->nibbles[k]);
+        masks[k] = 0;
+    }
+    nibble = _mm_set1_epi8(0x0F);
+    bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    zero = _mm_setzero_si128();
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        v = _mm_loadu_si128((const __m128i *)(str + i));
+
+        lo = _mm_and_si128(v, nibble);
+        hi = _mm_shuffle_epi8(bits,
+            _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+
+        for (k = 0; k < 3; ++k) {
+            m = _mm_cmpeq_epi8(
+                _mm_and_si128(_mm_shuffle_epi8(tables[k], lo), hi), zero);
+            masks[k] |= (unsigned long long)
+                (~(unsigned)_mm_movemask_epi8(m) & 0xFFFFu) << i;
+        }
+    }
+
+    if (i < len) {
+        hashids_scan_tail(hashids, str, len, i, masks);
+    }
+}
+
+/* 32 bytes per step (pshufb works per 128-bit lane) */
+__attribute__((target("avx2")))
+static void
+hashids_scan_avx2(const hashids_t *hashids, const char *str, size_t len,
+    unsigned long long masks[3])
+{
+    __m256i tables[3], nibble, bits, zero, v, lo, hi, m;
+    size_t i, k;
+
+    for (k = 0; k < 3; ++k) {
+        tables[k] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *)hashids->nibbles[k]));
+        masks[k] = 0;
+    }
+    nibble = _mm256_set1_epi8(0x0F);
+    bits = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+        0, 0, 0, 0, 0, 0, 0, 0,
+        1, 2, 4, 8, 16, 32, 64, (char)128,
+        0, 0, 0, 0, 0, 0, 0, 0);
+    zero = _mm256_setzero_si256();
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        v = _mm256_loadu_si256((const __m256i *)(str + i));
+
+        lo = _mm256_and_si256(v, nibble);
+        hi = _mm256_shuffle_epi8(bits,
+            _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+
+        for (k = 0; k < 3; ++k) {
+            m = _mm256_cmpeq_epi8(
+                _mm256_and_si256(_mm256_shuffle_epi8(tables[k], lo), hi),
+                zero);
+            masks[k] |= (unsigned long long)
+                (~(unsigned)_mm256_movemask_epi8(m)) << i;
+        }
+    }
+
+    if (i < len) {
+        hashids_scan_tail(hashids, str, len, i, masks);
+    }
+}
+#endif
+
+#ifdef HASHIDS_HAVE_NEON
+/* 16 bytes per step: tbl lookups, movemask emulated with weighted sums */
+static void
+hashids_scan_neon(const hashids_t *hashids, const char *str, size_t len,
+    unsigned long long masks[3])
+{
+    static const unsigned char bits_tab[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0
+    };
+    static const unsigned char weights_tab[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    uint8x16_t tables[3], bits, weights, nibble, v, lo, hi, m;
+    size_t i, k;
+
+    for (k = 0; k < 3; ++k) {
+        tables[k] = vld1q_u8(hashids->nibbles[k]);
+        masks[k] = 0;
+    }
+    bits = vld1q_u8(bits_tab);
+    weights = vld1q_u8(weights_tab);
+    nibble = vdupq_n_u8(0x0F);
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        v = vld1q_u8((const unsigned char *)str + i);
+
+        lo = vandq_u8(v, nibble);
+        hi = vqtbl1q_u8(bits, vshrq_n_u8(v, 4));
+
+        for (k = 0; k < 3; ++k) {
+            m = vandq_u8(vtstq_u8(vqtbl1q_u8(tables[k], lo), hi), weights);
+            masks[k] |= (unsigned long long)(vaddv_u8(vget_low_u8(m))
+                | (vaddv_u8(vget_high_u8(m)) << 8)) << i;
+        }
+    }
+
+    if (i < len) {
+        hashids_scan_tail(hashids, str, len, i, masks);
+    }
+}
+#endif
+
+/* pick the best kernel for this CPU and character set */
+static int
+hashids_scan_select(const hashids_t *hashids)
+{
+    size_t i;
+
+    /* the nibble tables only cover 7-bit bytes */
+    for (i = 128; i < 256; ++i) {
+        if (hashids->classes[i] != HASHIDS_CLASS_INVALID) {
+            return HASHIDS_SCAN_SCALAR;
+        }
+    }
+
+#if defined(HASHIDS_HAVE_X86_SIMD)
+    if (__builtin_cpu_supports("avx2")) {
+        return HASHIDS_SCAN_AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return HASHIDS_SCAN_SSSE3;
+    }
+#elif defined(HASHIDS_HAVE_NEON)
+    return HASHIDS_SCAN_NEON;
+#endif
+    (void)hashids;
+    return HASHIDS_SCAN_SCALAR;
+}
+
+/* classify up to 64 bytes with the instance's kernel */
+static inline void
+hashids_scan(const hashids_t *hashids, const char *str, size_t len,
+    unsigned long long masks[3])
+{
+    switch (hashids->scan_kernel) {
+#ifdef HASHIDS_HAVE_X86_SIMD
+        case HASHIDS_SCAN_AVX2:
+            hashids_scan_avx2(hashids, str, len, masks);
+            return;
+        case HASHIDS_SCAN_SSSE3:
+            hashids_scan_ssse3(hashids, str, len, masks);
+            return;
+#endif
+#ifdef HASHIDS_HAVE_NEON
+        case HASHIDS_SCAN_NEON:
+            hashids_scan_neon(hashids, str, len, masks);
+            return;
+#endif
+        default:
+            hashids_scan_scalar(hashids, str, len, masks);
+    }
+}
+
+/* offset of the hash body: just past the first guard (if any) */
+static inline size_t
+hashids_skip_guard(const hashids_t *hashids, const char *str, size_t len)
+{
+    unsigned long long masks[3];
+    size_t pos, block;
+
+    if (!hashids->min_hash_length) {
+        return 0;
+    }
+
+    for (pos = 0; pos < len; pos += HASHIDS_SCAN_BLOCK) {
+        block = len - pos < HASHIDS_SCAN_BLOCK ? len - pos : HASHIDS_SCAN_BLOCK;
+        hashids_scan(hashids, str + pos, block, masks);
+        if (masks[2]) {
+            return pos + hashids_ctz64(masks[2]) + 1;
+        }
+    }
+
+    return 0;
+}
+
+/* end of the hash body starting at pos: the closing guard, len, or the
+   first byte that is neither alphabet nor separator (flagged in *invalid),
+   with the separators before it counted, so garbage is caught before any
+   shuffle */
+static inline size_t
+hashids_body_end(const hashids_t *hashids, const char *str, size_t pos,
+    size_t len, size_t *separators_count, int *invalid)
+{
+    unsigned long long masks[3], stray;
+    size_t block, limit;
+
+    *separators_count = 0;
+    *invalid = 0;
+    for (; pos < len; pos += HASHIDS_SCAN_BLOCK) {
+        block = len - pos < HASHIDS_SCAN_BLOCK ? len - pos : HASHIDS_SCAN_BLOCK;
+        hashids_scan(hashids, str + pos, block, masks);
+
+        limit = masks[2] ? hashids_ctz64(masks[2]) : block;
+        stray = ~(masks[0] | masks[1]) & hashids_low_bits(limit);
+        if (HASHIDS_UNLIKELY(stray)) {
+            limit = hashids_ctz64(stray);
+            *invalid = 1;
+        }
+        *separators_count += hashids_popcount64(masks[1]
+            & hashids_low_bits(limit));
+
+        if (stray || masks[2]) {
+            return pos + limit;
+        }
+    }
+
+    return len;
+}
+
+/* where the parts of a hash are */
+struct hashids_body_s {
+    size_t start;               /* lottery position */
+    size_t end;                 /* closing guard, first stray byte or len */
+    size_t separators_count;    /* separators between start and end */
+    int invalid;                /* end is a stray byte */
+    int padding;                /* left padding is all alphabet bytes */
+};
+
+/* locate lottery, body & closing guard, catching stray bytes before any
+   shuffle (left padding only checked when asked); a hash of one block is
+   classified once and its masks kept for the parse (returns 1 then) */
+static inline int
+hashids_locate(const hashids_t *hashids, const char *str, size_t len,
+    int check_padding, struct hashids_body_s *body,
+    unsigned long long masks[3])
+{
+    unsigned long long region, stray;
+    size_t limit, count;
+    int invalid;
+
+    if (len > HASHIDS_SCAN_BLOCK) {
+        body->start = hashids_skip_guard(hashids, str, len);
+        if (body->start == len) {
+            return 0;
+        }
+        body->end = hashids_body_end(hashids, str, body->start + 1, len,
+            &body->separators_count, &body->invalid);
+
+        body->padding = 1;
+        if (check_padding && body->start > 1) {
+            hashids_body_end(hashids, str, 0, body->start - 1, &count,
+                &invalid);
+            body->padding = !invalid && !count;
+        }
+        return 0;
+    }
+
+    hashids_scan(hashids, str, len, masks);
+    body->start = hashids->min_hash_length && masks[2]
+        ? hashids_ctz64(masks[2]) + 1 : 0;
+    if (body->start == len) {
+        return 1;
+    }
+
+    region = hashids_low_bits(len) & ~hashids_low_bits(body->start + 1);
+    limit = masks[2] & region ? hashids_ctz64(masks[2] & region) : len;
+    region &= hashids_low_bits(limit);
+    stray = ~(masks[0] | masks[1]) & region;
+    if (HASHIDS_UNLIKELY(stray)) {
+        limit = hashids_ctz64(stray);
+        region &= hashids_low_bits(limit);
+    }
+
+    body->end = limit;
+    body->separators_count = hashids_popcount64(masks[1] & region);
+    body->invalid = stray != 0;
+    body->padding = !(~masks[0]
+        & hashids_low_bits(body->start ? body->start - 1 : 0));
+    return 1;
+}
+
+/* "destructor" */
+void
+hashids_free(hashids_t *hashids)
+{
+    if (hashids) {
+        if (hashids->shuffles) {
+            hashids_instance_free(hashids, hashids->shuffles);
+        }
+        if (hashids->permutations) {
+            hashids_instance_free(hashids, hashids->permutations);
+        }
+        if (hashids->padding) {
+            hashids_instance_free(hashids, hashids->padding);
+        }
+
+        hashids_instance_free(hashids,
+            (char *)hashids - hashids->block_offset);
+    }
+}
+
+/* allocate an empty instance as one aligned block */
+static hashids_t *
+hashids_instance_create(const hashids_allocator_t *allocator)
+{
+    hashids_t *result;
+    char *block;
+
+    if (!allocator) {
+        allocator = &hashids_default_allocator;
+    }
+
+    block = (char *)allocator->alloc(allocator->user_data,
+        HASHIDS_INSTANCE_SIZE + HASHIDS_CACHE_LINE - 1);
+    if (HASHIDS_UNLIKELY(!block)) {
+        return NULL;
+    }
+    result = (hashids_t *)(block + (HASHIDS_CACHE_LINE
+        - (size_t)block % HASHIDS_CACHE_LINE) % HASHIDS_CACHE_LINE);
+    result->block_offset = (char *)result - block;
+    result->allocator = *allocator;
+#ifdef HASHIDS_ENABLE_STATS
+    result->stats = (struct hashids_stats_slot_s *)(result + 1);
+#endif
+
+    return result;
+}
+
+/* derive the lookup tables from alphabet, separators, guards & salt (0 if
+   the permutation rows cannot be allocated) */
+static int
+hashids_build_tables(hashids_t *result)
+{
+    size_t i, k;
+    unsigned long long power;
+    unsigned char *row;
+    char salt[HASHIDS_PERMUTE_MAX];
+
+    /* reciprocals for the digit loops */
+    hashids_divisor_init(&result->alphabet_divisor, result->alphabet_length);
+    hashids_divisor_init(&result->alphabet_squared_divisor,
+        result->alphabet_length * result->alphabet_length);
+
+    /* powers for the digit counts */
+    for (i = 0, power = 1; power <= ~0ull / result->alphabet_length; ++i) {
+        power *= result->alphabet_length;
+        result->alphabet_powers[i] = power;
+    }
+    result->alphabet_powers_count = i;
+
+    /* build the character class table */
+    memset(result->classes, HASHIDS_CLASS_INVALID, sizeof(result->classes));
+    for (i = 0; i < result->alphabet_length; ++i) {
+        result->classes[(unsigned char)result->alphabet[i]] =
+            HASHIDS_CLASS_ALPHABET;
+    }
+    for (i = 0; i < result->separators_count; ++i) {
+        result->classes[(unsigned char)result->separators[i]] =
+            HASHIDS_CLASS_SEPARATOR;
+    }
+    for (i = 0; i < result->guards_count; ++i) {
+        result->classes[(unsigned char)result->guards[i]] =
+            HASHIDS_CLASS_GUARD;
+    }
+
+    /* build the alphabet position table */
+    memset(result->indexes, HASHIDS_INDEX_NONE, sizeof(result->indexes));
+    for (i = 0; i < result->alphabet_length; ++i) {
+        result->indexes[(unsigned char)result->alphabet[i]] = (unsigned char)i;
+    }
+
+    /* build the nibble bitsets: bit (c >> 4) of entry (c & 15) */
+    memset(result->nibbles, 0, sizeof(result->nibbles));
+    for (i = 1; i < 128; ++i) {
+        switch (result->classes[i]) {
+            case HASHIDS_CLASS_ALPHABET:
+                result->nibbles[0][i & 15] |= (unsigned char)(1u << (i >> 4));
+                break;
+            case HASHIDS_CLASS_SEPARATOR:
+                result->nibbles[1][i & 15] |= (unsigned char)(1u << (i >> 4));
+                break;
+            case HASHIDS_CLASS_GUARD:
+                result->nibbles[2][i & 15] |= (unsigned char)(1u << (i >> 4));
+                break;
+        }
+    }
+    result->scan_kernel = hashids_scan_select(result);
+
+    /* no precomputed shuffles until asked for */
+    result->shuffles = NULL;
+    result->shuffles_digits = NULL;
+    result->shuffles_depth = 0;
+    result->padding = NULL;
+    result->padding_depth = 0;
+    result->padding_rounds = 0;
+
+    /* with salt_length >= alphabet_length - 1 the salt of every per-number
+       shuffle is the lottery and a fixed salt prefix: compile them */
+    result->permutations = NULL;
+    result->permute_kernel = hashids_permute_select();
+    if (result->salt_length + 1 < result->alphabet_length
+        || result->alphabet_length > HASHIDS_PERMUTE_MAX) {
+        return 1;
+    }
+
+    result->permutations = (unsigned char *)hashids_instance_alloc(result,
+        result->alphabet_length * HASHIDS_PERMUTE_MAX);
+    if (HASHIDS_UNLIKELY(!result->permutations)) {
+        return 0;
+    }
+    memcpy(salt + 1, result->salt, result->alphabet_length - 1);
+    for (i = 0; i < result->alphabet_length; ++i) {
+        /* the swaps never look at the string: shuffling the identity
+           records them */
+        row = result->permutations + i * HASHIDS_PERMUTE_MAX;
+        for (k = 0; k < HASHIDS_PERMUTE_MAX; ++k) {
+            row[k] = (unsigned char)k;
+        }
+        salt[0] = result->alphabet[i];
+        hashids_shuffle((char *)row, result->alphabet_length, salt,
+            result->alphabet_length);
+    }
+
+    return 1;
+}
+
+/* common init, with a caller-supplied allocator (NULL for the default) */
 hashids_t *
-hashids_init(const char *salt)
+hashids_init4(const char *salt, size_t min_hash_length, const char *alphabet,
+    const hashids_allocator_t *allocator)
+{
+    hashids_t *result;
+    size_t i, j, len, salt_length;
+    char ch, *p;
+
+    hashids_errno = HASHIDS_ERROR_OK;
+
+    /* allocate the whole instance as one aligned block */
+    result = hashids_instance_create(allocator);
+    if (HASHIDS_UNLIKELY(!result)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return NULL;
+    }
+
+    /* extract only the unique characters */
+    len = strlen(alphabet) + 1;
+    result->alphabet[0] = '\0';
+    for (i = 0, j = 0; i < len; ++i) {
+        ch = alphabet[i];
+        if (!strchr(result->alphabet, ch)) {
+            result->alphabet[j++] = ch;
+        }
+    }
+    result->alphabet[j] = '\0';
+
+    /* store alphabet length */
+    result->alphabet_length = j;
+
+    /* check length and whitespace */
+    if (result->alphabet_length < HASHIDS_MIN_ALPHABET_LENGTH) {
+        hashids_free(result);
+        hashids_errno = HASHIDS_ERROR_ALPHABET_LENGTH;
+        return NULL;
+    }
+    if (strchr(result->alphabet, 0x20) || strchr(result->alphabet, 0x09)) {
+        hashids_free(result);
+        hashids_errno = HASHIDS_ERROR_ALPHABET_SPACE;
+        return NULL;
+    }
+
+    /* keep the part of the salt used after init */
+    salt_length = salt ? strlen(salt) : 0;
+    result->salt_length = salt_length < HASHIDS_MAX_ALPHABET_LENGTH
+        ? salt_length : HASHIDS_MAX_ALPHABET_LENGTH;
+    if (salt_length) {
+        memcpy(result->salt, salt, result->salt_length);
+    }
+
+    /* take default separators out of the alphabet */
+    for (i = 0, j = 0; i < strlen(HASHIDS_DEFAULT_SEPARATORS); ++i) {
+        ch = HASHIDS_DEFAULT_SEPARATORS[i];
+
+        /* check if separator is actually in the used alphabet */
+        if ((p = strchr(result->alphabet, ch))) {
+            result->separators[j++] = ch;
+
+            /* remove that separator */
+            memmove(p, p + 1,
+                strlen(result->alphabet) - (p - result->alphabet));
+        }
+    }
+
+    /* store separators length */
+    result->separators_count = j;
+
+    /* subtract separators count from alphabet length */
+    result->alphabet_length -= result->separators_count;
+
+    /* shuffle the separators (with the whole salt) */
+    if (result->separators_count) {
+        hashids_shuffle(result->separators, result->separators_count,
+            (char *)salt, salt_length);
+    }
+
+    /* check if we have any/enough separators */
+    if (!result->separators_count
+        || (((float)result->alphabet_length / (float)result->separators_count)
+            > HASHIDS_SEPARATOR_DIVISOR)) {
+        size_t separators_count = (size_t)ceil(
+            (float)result->alphabet_length / HASHIDS_SEPARATOR_DIVISOR);
+
+        if (separators_count == 1) {
+            separators_count = 2;
+        }
+
+        if (separators_count > result->separators_count) {
+            /* we need more separators - get some from alphabet */
+            size_t diff = separators_count - result->separators_count;
+            strncat(result->separators, result->alphabet, diff);
+            memmove(result->alphabet, result->alphabet + diff,
+                result->alphabet_length - diff + 1);
+
+            result->separators_count += diff;
+            result->alphabet_length -= diff;
+        } else {
+            /* we have more than enough - truncate */
+            result->separators[separators_count] = '\0';
+            result->separators_count = separators_count;
+        }
+    }
+
+    /* shuffle alphabet */
+    hashids_shuffle(result->alphabet, result->alphabet_length,
+        (char *)salt, salt_length);
+
+    /* take the guards */
+    result->guards_count = hashids_div_ceil_size_t(result->alphabet_length,
+        HASHIDS_GUARD_DIVISOR);
+
+    if (HASHIDS_UNLIKELY(result->alphabet_length < 3)) {
+        /* take some from separators */
+        memcpy(result->guards, result->separators, result->guards_count);
+        memmove(result->separators, result->separators + result->guards_count,
+            result->separators_count - result->guards_count + 1);
+
+        result->separators_count -= result->guards_count;
+    } else {
+        /* take them from alphabet */
+        memcpy(result->guards, result->alphabet, result->guards_count);
+        memmove(result->alphabet, result->alphabet + result->guards_count,
+            result->alphabet_length - result->guards_count + 1);
+
+        result->alphabet_length -= result->guards_count;
+    }
+
+    /* set min hash length */
+    result->min_hash_length = min_hash_length;
+
+    /* lookup tables */
+    if (HASHIDS_UNLIKELY(!hashids_build_tables(result))) {
+        hashids_free(result);
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return NULL;
+    }
+
+    /* return result happily */
+    return result;
+}
+
+/* common init */
+hashids_t *
+hashids_init3(const char *salt, size_t min_hash_length, const char *alphabet)
+{
+    return hashids_init4(salt, min_hash_length, alphabet, NULL);
+}
+
+/* init with salt and minimum hash length */
+hashids_t *
+hashids_init2(const char *salt, size_t min_hash_length)
+{
+    return hashids_init3(salt, min_hash_length, HASHIDS_DEFAULT_ALPHABET);
+}
+
+/* init with hash only */
+hashids_t *
+hashids_init(const char *salt)
+{
+    return hashids_init2(salt, HASHIDS_DEFAULT_MIN_HASH_LENGTH);
+}
+
+/* bytes owned by an instance: its block, the permutation rows and the
+   shuffle & padding caches */
+size_t
+hashids_footprint(const hashids_t *hashids)
+{
+    return HASHIDS_INSTANCE_SIZE + HASHIDS_CACHE_LINE - 1
+        + (hashids->permutations
+            ? hashids->alphabet_length * HASHIDS_PERMUTE_MAX : 0)
+        + 2 * hashids->shuffles_depth * hashids->alphabet_length
+        * hashids->alphabet_length
+        + hashids->padding_depth * hashids->padding_rounds
+        * hashids->alphabet_length * hashids->alphabet_length;
+}
+
+#ifdef HASHIDS_ENABLE_STATS
+/* sum of every thread's counters so far (each counter is read atomically,
+   the whole is not a consistent cut) */
+void
+hashids_stats_snapshot(const hashids_t *hashids, hashids_stats_t *stats)
+{
+    const unsigned long long *slot;
+    unsigned long long *sum;
+    size_t i, k, n;
+
+    memset(stats, 0, sizeof(*stats));
+    sum = (unsigned long long *)stats;
+    n = sizeof(*stats) / sizeof(*sum);
+
+    for (i = 0; i < HASHIDS_STATS_SLOTS; ++i) {
+        slot = (const unsigned long long *)&hashids->stats[i].stats;
+        for (k = 0; k < n; ++k) {
+            sum[k] += hashids_atomic_load(&slot[k]);
+        }
+    }
+}
+
+/* add other's counters to stats (e.g. across instances) */
+void
+hashids_stats_merge(hashids_stats_t *stats, const hashids_stats_t *other)
+{
+    const unsigned long long *from;
+    unsigned long long *to;
+    size_t k;
+
+    to = (unsigned long long *)stats;
+    from = (const unsigned long long *)other;
+    for (k = 0; k < sizeof(*stats) / sizeof(*to); ++k) {
+        to[k] += from[k];
+    }
+}
+
+/* zero every counter (operations in flight may land either side) */
+void
+hashids_stats_reset(const hashids_t *hashids)
+{
+    unsigned long long *slot;
+    size_t i, k;
+
+    for (i = 0; i < HASHIDS_STATS_SLOTS; ++i) {
+        slot = (unsigned long long *)&hashids->stats[i].stats;
+        for (k = 0; k < sizeof(hashids_stats_t) / sizeof(*slot); ++k) {
+            hashids_atomic_store(&slot[k], 0ull);
+        }
+    }
+}
+#endif
+
+/* precompute the first `depth` shuffled alphabets (and their digit tables)
+   for every lottery (call before sharing the instance; depth 0 drops the
+   cache) */
+int
+hashids_cache_shuffles(hashids_t *hashids, size_t depth)
+{
+    size_t i, k, alphabet_length;
+    const char *alphabet;
+    char *shuffles;
+    unsigned char *digits;
+    hashids_ctx_t ctx;
+    int p_max;
+
+    alphabet_length = hashids->alphabet_length;
+
+    if (hashids->shuffles) {
+        hashids_instance_free(hashids, hashids->shuffles);
+        hashids->shuffles = NULL;
+        hashids->shuffles_digits = NULL;
+        hashids->shuffles_depth = 0;
+    }
+
+    if (!depth) {
+        return HASHIDS_ERROR_OK;
+    }
+
+    /* one alphabet and one digit table per lottery character and number
+       position */
+    if (HASHIDS_UNLIKELY(depth > (size_t)-1 / 2 / alphabet_length
+        / alphabet_length)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return HASHIDS_ERROR_ALLOC;
+    }
+    shuffles = (char *)hashids_instance_alloc(hashids,
+        2 * depth * alphabet_length * alphabet_length);
+    if (HASHIDS_UNLIKELY(!shuffles)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return HASHIDS_ERROR_ALLOC;
+    }
+    digits = (unsigned char *)shuffles + depth * alphabet_length
+        * alphabet_length;
+
+    p_max = hashids_prepare_salt(hashids, &ctx);
+    for (i = 0; i < alphabet_length; ++i) {
+        ctx.alphabet_copy_2[0] = hashids->alphabet[i];
+
+        for (k = 0, alphabet = hashids->alphabet; k < depth; ++k) {
+            alphabet = hashids_next_alphabet(hashids, &ctx, p_max, alphabet,
+                NULL, k);
+            memcpy(shuffles + (i * depth + k) * alphabet_length, alphabet,
+                alphabet_length);
+            hashids_invert_alphabet(hashids, alphabet,
+                digits + (i * depth + k) * alphabet_length);
+        }
+    }
+
+    hashids->shuffles = shuffles;
+    hashids->shuffles_digits = digits;
+    hashids->shuffles_depth = depth;
+
+    return HASHIDS_ERROR_OK;
+}
+
+/* snapshot layout (all integers little-endian):
+     0  "HIDS"
+     4  u32 format version
+     8  u32 checksum of everything that follows
+    12  u32 alphabet length, separators count, guards count, salt length
+    28  u64 min hash length, shuffle cache depth
+    44  alphabet, separators, guards, salt, cached shuffles (no NULs) */
+#define HASHIDS_SNAPSHOT_HEADER_SIZE 44u
+
+static inline void
+hashids_put_le(unsigned char *p, unsigned long long value, size_t size)
+{
+    for (; size--; value >>= 8) {
+        *p++ = (unsigned char)value;
+    }
+}
+
+static inline unsigned long long
+hashids_get_le(const unsigned char *p, size_t size)
+{
+    unsigned long long value;
+
+    for (value = 0; size--; ) {
+        value = value << 8 | p[size];
+    }
+    return value;
+}
+
+/* (spelled out so compilers emit a single load) */
+static inline unsigned long long
+hashids_get_le64(const unsigned char *p)
+{
+    return (unsigned long long)p[0] | (unsigned long long)p[1] << 8
+        | (unsigned long long)p[2] << 16 | (unsigned long long)p[3] << 24
+        | (unsigned long long)p[4] << 32 | (unsigned long long)p[5] << 40
+        | (unsigned long long)p[6] << 48 | (unsigned long long)p[7] << 56;
+}
+
+/* FNV-style checksum, a 64-bit word at a time, folded to 32 bits */
+static unsigned long
+hashids_snapshot_checksum(const unsigned char *p, size_t size)
+{
+    unsigned long long hash;
+
+    for (hash = 0xCBF29CE484222325ull; size >= 8; p += 8, size -= 8) {
+        hash = (hash ^ hashids_get_le64(p)) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    hash = (hash ^ hashids_get_le(p, size) ^ (unsigned long long)size << 56)
+        * 0x100000001B3ull;
+
+    return (unsigned long)((hash ^ hash >> 32) & 0xFFFFFFFFul);
+}
+
+/* serialize an instance and its shuffle cache; returns the snapshot size
+   and writes only if buffer_size is large enough */
+size_t
+hashids_snapshot_save(const hashids_t *hashids, void *buffer,
+    size_t buffer_size)
+{
+    size_t size, cache_size;
+    unsigned char *p;
+
+    cache_size = hashids->shuffles_depth * hashids->alphabet_length
+        * hashids->alphabet_length;
+    size = HASHIDS_SNAPSHOT_HEADER_SIZE + hashids->alphabet_length
+        + hashids->separators_count + hashids->guards_count
+        + hashids->salt_length + cache_size;
+    if (!buffer || buffer_size < size) {
+        return size;
+    }
+
+    p = (unsigned char *)buffer;
+    memcpy(p, "HIDS", 4);
+    hashids_put_le(p + 4, HASHIDS_SNAPSHOT_VERSION, 4);
+    hashids_put_le(p + 12, hashids->alphabet_length, 4);
+    hashids_put_le(p + 16, hashids->separators_count, 4);
+    hashids_put_le(p + 20, hashids->guards_count, 4);
+    hashids_put_le(p + 24, hashids->salt_length, 4);
+    hashids_put_le(p + 28, hashids->min_hash_length, 8);
+    hashids_put_le(p + 36, hashids->shuffles_depth, 8);
+
+    p += HASHIDS_SNAPSHOT_HEADER_SIZE;
+    memcpy(p, hashids->alphabet, hashids->alphabet_length);
+    p += hashids->alphabet_length;
+    memcpy(p, hashids->separators, hashids->separators_count);
+    p += hashids->separators_count;
+    memcpy(p, hashids->guards, hashids->guards_count);
+    p += hashids->guards_count;
+    memcpy(p, hashids->salt, hashids->salt_length);
+    p += hashids->salt_length;
+    if (cache_size) {
+        memcpy(p, hashids->shuffles, cache_size);
+    }
+
+    p = (unsigned char *)buffer;
+    hashids_put_le(p + 8, hashids_snapshot_checksum(p + 12, size - 12), 4);
+
+    return size;
+}
+
+/* copy `count` bytes of one character set, refusing NULs, blanks and
+   bytes already taken by another set */
+static inline int
+hashids_snapshot_set(char *set, const unsigned char *p, size_t count,
+    unsigned char *seen)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i) {
+        if (!p[i] || p[i] == 0x20 || p[i] == 0x09 || seen[p[i]]) {
+            return 0;
+        }
+        seen[p[i]] = 1;
+        set[i] = (char)p[i];
+    }
+    set[count] = '\0';
+    return 1;
+}
+
+/* rebuild an instance from a snapshot (a plain buffer or a read-only
+   mapping); every length is checked against the buffer before use and the
+   scan kernel is picked for this CPU */
+hashids_t *
+hashids_snapshot_load(const void *buffer, size_t size,
+    const hashids_allocator_t *allocator)
+{
+    const unsigned char *p;
+    unsigned char seen[256], ch;
+    unsigned long long min_hash_length, depth;
+    size_t alphabet_length, separators_count, guards_count, salt_length,
+        fixed, cache_size, i, k;
+    hashids_t *result;
+    char *shuffles;
+
+    hashids_errno = HASHIDS_ERROR_OK;
+
+    /* header */
+    p = (const unsigned char *)buffer;
+    if (HASHIDS_UNLIKELY(!p || size < HASHIDS_SNAPSHOT_HEADER_SIZE
+        || memcmp(p, "HIDS", 4)
+        || hashids_get_le(p + 4, 4) != HASHIDS_SNAPSHOT_VERSION
+        || hashids_get_le(p + 8, 4)
+            != hashids_snapshot_checksum(p + 12, size - 12))) {
+        hashids_errno = HASHIDS_ERROR_INVALID_SNAPSHOT;
+        return NULL;
+    }
+    alphabet_length = (size_t)hashids_get_le(p + 12, 4);
+    separators_count = (size_t)hashids_get_le(p + 16, 4);
+    guards_count = (size_t)hashids_get_le(p + 20, 4);
+    salt_length = (size_t)hashids_get_le(p + 24, 4);
+    min_hash_length = hashids_get_le(p + 28, 8);
+    depth = hashids_get_le(p + 36, 8);
+
+    /* lengths init could have produced, and exactly the buffer's size */
+    fixed = HASHIDS_SNAPSHOT_HEADER_SIZE + alphabet_length + separators_count
+        + guards_count + salt_length;
+    if (HASHIDS_UNLIKELY(alphabet_length < 2
+        || alphabet_length > HASHIDS_MAX_ALPHABET_LENGTH
+        || !separators_count
+        || separators_count > HASHIDS_MAX_SEPARATORS_COUNT
+        || !guards_count || guards_count > HASHIDS_MAX_GUARDS_COUNT
+        || salt_length > HASHIDS_MAX_ALPHABET_LENGTH
+        || min_hash_length > (size_t)-1
+        || fixed > size
+        || depth > (size - fixed) / alphabet_length / alphabet_length
+        || fixed + depth * alphabet_length * alphabet_length != size)) {
+        hashids_errno = HASHIDS_ERROR_INVALID_SNAPSHOT;
+        return NULL;
+    }
+    cache_size = (size_t)depth * alphabet_length * alphabet_length;
+
+    result = hashids_instance_create(allocator);
+    if (HASHIDS_UNLIKELY(!result)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return NULL;
+    }
+
+    /* character sets: disjoint, no NULs, no blanks */
+    memset(seen, 0, sizeof(seen));
+    p += HASHIDS_SNAPSHOT_HEADER_SIZE;
+    if (HASHIDS_UNLIKELY(!hashids_snapshot_set(result->alphabet, p,
+            alphabet_length, seen)
+        || !hashids_snapshot_set(result->separators, p + alphabet_length,
+            separators_count, seen)
+        || !hashids_snapshot_set(result->guards, p + alphabet_length
+            + separators_count, guards_count, seen)
+        || memchr(p + fixed - HASHIDS_SNAPSHOT_HEADER_SIZE - salt_length, 0,
+            salt_length))) {
+        hashids_free(result);
+        hashids_errno = HASHIDS_ERROR_INVALID_SNAPSHOT;
+        return NULL;
+    }
+    result->alphabet_length = alphabet_length;
+    result->separators_count = separators_count;
+    result->guards_count = guards_count;
+    result->salt_length = salt_length;
+    memcpy(result->salt, p + fixed - HASHIDS_SNAPSHOT_HEADER_SIZE
+        - salt_length, salt_length);
+    result->salt[salt_length] = '\0';
+    result->min_hash_length = (size_t)min_hash_length;
+
+    /* lookup tables */
+    if (HASHIDS_UNLIKELY(!hashids_build_tables(result))) {
+        hashids_free(result);
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return NULL;
+    }
+
+    /* shuffle cache: every entry must be a permutation of the alphabet */
+    if (!cache_size) {
+        return result;
+    }
+    shuffles = (char *)hashids_instance_alloc(result, 2 * cache_size);
+    if (HASHIDS_UNLIKELY(!shuffles)) {
+        hashids_free(result);
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return NULL;
+    }
+    memcpy(shuffles, p + fixed - HASHIDS_SNAPSHOT_HEADER_SIZE, cache_size);
+    result->shuffles = shuffles;
+    result->shuffles_digits = (unsigned char *)shuffles + cache_size;
+    result->shuffles_depth = (size_t)depth;
+
+    for (i = 0; i < cache_size; i += alphabet_length) {
+        memset(seen, 0, sizeof(seen));
+        for (k = 0; k < alphabet_length; ++k) {
+            ch = (unsigned char)shuffles[i + k];
+            if (HASHIDS_UNLIKELY(result->indexes[ch] == HASHIDS_INDEX_NONE
+                || seen[ch])) {
+                hashids_free(result);
+                hashids_errno = HASHIDS_ERROR_INVALID_SNAPSHOT;
+                return NULL;
+            }
+            seen[ch] = 1;
+        }
+        hashids_invert_alphabet(result, shuffles + i,
+            result->shuffles_digits + i);
+    }
+
+    return result;
+}
+
+/* estimate buffer size (generic) */
+size_t
+hashids_estimate_encoded_size(const hashids_t *hashids,
+    size_t numbers_count, const unsigned long long *numbers)
+{
+    size_t i, result_len;
+
+    for (i = 0, result_len = 1; i < numbers_count; ++i) {
+        if (numbers[i] == 0) {
+            result_len += 1;
+        } else {
+            /* bit length over floor(log2(alphabet_length)) never undershoots */
+            result_len += hashids_div_ceil_unsigned_short(
+                hashids_log2_64(numbers[i]) + 1,
+                hashids_log2_64(hashids->alphabet_length));
+        }
+    }
+
+    if (numbers_count > 1) {
+        result_len += numbers_count - 1;
+    }
+
+    if (result_len < hashids->min_hash_length) {
+        result_len = hashids->min_hash_length;
+    }
+
+    return result_len + 1 /* terminating NUL */;
+}
+
+/* estimate buffer size (variadic) */
+size_t
+hashids_estimate_encoded_size_v(hashids_t *hashids,
+    size_t numbers_count, ...)
+{
+    size_t i, result;
+    unsigned long long *numbers;
+    va_list ap;
+
+    numbers = (unsigned long long *)hashids_instance_alloc(hashids,
+        numbers_count * sizeof(unsigned long long));
+
+    if (HASHIDS_UNLIKELY(!numbers)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return 0;
+    }
+
+    va_start(ap, numbers_count);
+    for (i = 0; i < numbers_count; ++i) {
+        numbers[i] = va_arg(ap, unsigned long long);
+    }
+    va_end(ap);
+
+    result = hashids_estimate_encoded_size(hashids, numbers_count, numbers);
+    hashids_instance_free(hashids, numbers);
+
+    return result;
+}
+
+/* left & right padding added around an intermediate hash of result_len */
+static inline void
+hashids_padding(const hashids_t *hashids, size_t result_len, size_t *left,
+    size_t *right)
+{
+    size_t i, j, half_length_ceil, half_length_floor;
+
+    half_length_ceil = hashids_div_ceil_size_t(hashids->alphabet_length, 2);
+    half_length_floor = floor((float)hashids->alphabet_length / 2);
+
+    /* left pad from the end of the alphabet */
+    i = hashids_div_ceil_size_t(hashids->min_hash_length - result_len, 2);
+    /* right pad from the beginning */
+    j = floor((float)(hashids->min_hash_length - result_len) / 2);
+
+    /* check bounds */
+    if (i > half_length_ceil) {
+        i = half_length_ceil;
+    }
+    if (j > half_length_floor) {
+        j = half_length_floor;
+    }
+
+    /* handle excessively excessive excess */
+    if ((i + j) % 2 == 0 && hashids->alphabet_length % 2 == 1) {
+        ++i; --j;
+    }
+
+    *left = i;
+    *right = j;
+}
+
+/* where encode puts an intermediate hash of core_len bytes: its offset
+   past the left padding & guard, and the final length */
+static inline size_t
+hashids_layout(const hashids_t *hashids, size_t core_len, size_t *offset)
+{
+    size_t result_len, left, l, r;
+
+    /* no guards when the intermediate string is long enough */
+    if (core_len >= hashids->min_hash_length) {
+        *offset = 0;
+        return core_len;
+    }
+
+    /* a guard on each side, then padding grown outwards */
+    result_len = core_len + 1 + (core_len + 1 < hashids->min_hash_length);
+    for (left = 0; result_len < hashids->min_hash_length; ) {
+        hashids_padding(hashids, result_len, &l, &r);
+        left += l;
+        result_len += l + r;
+    }
+
+    *offset = left + 1;
+    return result_len;
+}
+
+/* padding rounds around an intermediate hash of core_len bytes (never
+   more than for the shortest one, lottery & a digit) */
+static size_t
+hashids_padding_rounds(const hashids_t *hashids, size_t core_len)
+{
+    size_t rounds, len, l, r;
+
+    for (rounds = 0, len = core_len + 2; len < hashids->min_hash_length;
+        ++rounds) {
+        hashids_padding(hashids, len, &l, &r);
+        len += l + r;
+    }
+
+    return rounds;
+}
+
+/* the cached padding alphabets for a lottery & number count, or NULL */
+static inline const char *
+hashids_padding_rows(const hashids_t *hashids, char lottery,
+    size_t numbers_count)
+{
+    if (!hashids->padding || numbers_count > hashids->padding_depth) {
+        return NULL;
+    }
+
+    return hashids->padding + ((size_t)hashids->indexes[(unsigned char)
+        lottery] * hashids->padding_depth + numbers_count - 1)
+        * hashids->padding_rounds * hashids->alphabet_length;
+}
+
+/* precompute, for the configured min_hash_length, the padding alphabets of
+   hashes of up to `depth` numbers for every lottery, so padding takes no
+   shuffles (call before sharing the instance; depth 0 drops the cache) */
+int
+hashids_cache_padding(hashids_t *hashids, size_t depth)
+{
+    size_t i, k, t, rounds, alphabet_length;
+    const char *alphabet;
+    char *padding, *row;
+    hashids_ctx_t ctx;
+    int p_max;
+
+    alphabet_length = hashids->alphabet_length;
+
+    if (hashids->padding) {
+        hashids_instance_free(hashids, hashids->padding);
+        hashids->padding = NULL;
+        hashids->padding_depth = 0;
+        hashids->padding_rounds = 0;
+    }
+
+    /* nothing to cache without padding */
+    rounds = hashids_padding_rounds(hashids, 2);
+    if (!depth || !rounds) {
+        return HASHIDS_ERROR_OK;
+    }
+
+    /* one alphabet per round, lottery character and number count */
+    if (HASHIDS_UNLIKELY(depth > (size_t)-1 / rounds / alphabet_length
+        / alphabet_length)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return HASHIDS_ERROR_ALLOC;
+    }
+    padding = (char *)hashids_instance_alloc(hashids,
+        depth * rounds * alphabet_length * alphabet_length);
+    if (HASHIDS_UNLIKELY(!padding)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return HASHIDS_ERROR_ALLOC;
+    }
+
+    p_max = hashids_prepare_salt(hashids, &ctx);
+    for (i = 0; i < alphabet_length; ++i) {
+        ctx.alphabet_copy_2[0] = hashids->alphabet[i];
+
+        for (k = 0, alphabet = hashids->alphabet; k < depth; ++k) {
+            alphabet = hashids_next_alphabet(hashids, &ctx, p_max, alphabet,
+                NULL, k);
+
+            /* the chain encode would shuffle after k + 1 numbers */
+            row = padding + (i * depth + k) * rounds * alphabet_length;
+            memcpy(row, alphabet, alphabet_length);
+            hashids_shuffle(row, alphabet_length, (char *)alphabet,
+                alphabet_length);
+            for (t = 1; t < rounds; ++t, row += alphabet_length) {
+                memcpy(row + alphabet_length, row, alphabet_length);
+                hashids_shuffle(row + alphabet_length, alphabet_length, row,
+                    alphabet_length);
+            }
+        }
+    }
+
+    hashids->padding = padding;
+    hashids->padding_depth = depth;
+    hashids->padding_rounds = rounds;
+
+    return HASHIDS_ERROR_OK;
+}
+
+/* digits of a number in the alphabet's base */
+static inline size_t
+hashids_digits_count(const hashids_t *hashids, unsigned long long number)
+{
+    size_t k;
+
+    for (k = 0; k < hashids->alphabet_powers_count
+        && number >= hashids->alphabet_powers[k]; ++k) {
+        /* empty */
+    }
+    return k + 1;
+}
+
+/* fill in guards & padding around the intermediate hash already in place
+   at buffer + offset (alphabet is the one the last of numbers_count numbers
+   was encoded with) */
+static size_t
+hashids_encode_finish(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, size_t offset, size_t core_len, size_t result_len,
+    unsigned long long numbers_hash, size_t numbers_count,
+    const char *alphabet)
+{
+    size_t i, k, l, r, len;
+    const char *rows, *pad;
+    char padding_salt[HASHIDS_MAX_ALPHABET_LENGTH + 1];
+
+    if (offset) {
+        /* add a guard before the encoded numbers */
+        buffer[offset - 1] = hashids->guards[(numbers_hash + buffer[offset])
+            % hashids->guards_count];
+
+        if (result_len > core_len + 1) {
+            /* add a guard after the encoded numbers */
+            buffer[offset + core_len] = hashids->guards[(numbers_hash
+                + buffer[offset + 1]) % hashids->guards_count];
+
+            /* padding alphabets: cached, or shuffled in place */
+            rows = hashids_padding_rows(hashids, buffer[offset],
+                numbers_count);
+            if (!rows && alphabet != ctx->alphabet_copy_1) {
+                memcpy(ctx->alphabet_copy_1, alphabet,
+                    hashids->alphabet_length);
+            }
+
+            /* pad, pad, pad: half alphabets, outwards */
+            for (i = offset - 1, k = offset + core_len + 1,
+                len = core_len + 2; len < result_len; ) {
+                if (rows) {
+                    pad = rows;
+                    rows += hashids->alphabet_length;
+                } else {
+                    memcpy(padding_salt, ctx->alphabet_copy_1,
+                        hashids->alphabet_length);
+                    hashids_shuffle(ctx->alphabet_copy_1,
+                        hashids->alphabet_length, padding_salt,
+                        hashids->alphabet_length);
+                    HASHIDS_STATS_ADD(hashids, shuffles, 1);
+                    pad = ctx->alphabet_copy_1;
+                }
+                HASHIDS_STATS_ADD(hashids, padding_iterations, 1);
+
+                hashids_padding(hashids, len, &l, &r);
+                i -= l;
+                memcpy(buffer + i, pad + hashids->alphabet_length - l, l);
+                memcpy(buffer + k, pad, r);
+                k += r;
+                len += l + r;
+            }
+        }
+    }
+
+    buffer[result_len] = '\0';
+    return result_len;
+}
+
+/* encode many into a prepared context: lengths first, then every byte
+   written once, in its final place */
+static size_t
+hashids_encode_prepared(const hashids_t *hashids, hashids_ctx_t *ctx,
+    int p_max, char *buffer, size_t numbers_count,
+    const unsigned long long *numbers)
+{
+    size_t i, core_len, offset, result_len;
+    unsigned long long number, numbers_hash, quotient, remainder;
+    const char *alphabet, *cached;
+    char lottery, *p, *q, *segment_end;
+    HASHIDS_STATS_TIMER(start);
+
+    /* walk arguments once: the hash and the intermediate length (lottery,
+       digits & separators) */
+    for (i = 0, numbers_hash = 0, core_len = numbers_count;
+        i < numbers_count; ++i) {
+        number = numbers[i];
+        numbers_hash += number % (i + 100);
+        core_len += hashids_digits_count(hashids, number);
+    }
+    result_len = hashids_layout(hashids, core_len, &offset);
+
+    /* lottery character */
+    lottery = hashids->alphabet[numbers_hash % hashids->alphabet_length];
+
+    /* start the intermediate hash with it (or don't) */
+    p = buffer + offset;
+    *p++ = lottery;
+
+    /* the salt part of scratch buffer 2 is already in place */
+    ctx->alphabet_copy_2[0] = lottery;
+
+    /* precomputed alphabets for this lottery, if any */
+    cached = hashids->shuffles ? hashids->shuffles
+        + (numbers_hash % hashids->alphabet_length) * hashids->shuffles_depth
+        * hashids->alphabet_length : NULL;
+
+    for (i = 0, alphabet = hashids->alphabet; i < numbers_count; ++i) {
+        /* take number */
+        number = numbers[i];
+
+        /* shuffle the alphabet */
+        alphabet = hashids_next_alphabet(hashids, ctx, p_max, alphabet, cached,
+            i);
+
+        /* hash the number from its last digit back, two digits at a time
+           while we can */
+        segment_end = q = p + hashids_digits_count(hashids, number);
+        while (number >= hashids->alphabet_squared_divisor.divisor) {
+            quotient = hashids_divide(&hashids->alphabet_squared_divisor,
+                number);
+            remainder = number
+                - quotient * hashids->alphabet_squared_divisor.divisor;
+            number = hashids_divide(&hashids->alphabet_divisor, remainder);
+            *--q = alphabet[remainder - number * hashids->alphabet_length];
+            *--q = alphabet[number];
+            number = quotient;
+        }
+        do {
+            quotient = hashids_divide(&hashids->alphabet_divisor, number);
+            *--q = alphabet[number - quotient * hashids->alphabet_length];
+            number = quotient;
+        } while (number);
+
+        /* separator, picked by the number's first character */
+        if (i + 1 < numbers_count) {
+            *segment_end = hashids->separators[numbers[i] % (*p + i)
+                % hashids->separators_count];
+            p = segment_end + 1;
+        }
+    }
+
+    i = hashids_encode_finish(hashids, ctx, buffer, offset, core_len,
+        result_len, numbers_hash, numbers_count, alphabet);
+    HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_ENCODE, start, i,
+        HASHIDS_ERROR_OK);
+
+    return i;
+}
+
+/* encode many (generic, reentrant) */
+size_t
+hashids_encode_r(const hashids_t *hashids, hashids_ctx_t *ctx, char *buffer,
+    size_t numbers_count, const unsigned long long *numbers)
+{
+    /* bail out if no numbers */
+    if (HASHIDS_UNLIKELY(!numbers_count)) {
+        buffer[0] = '\0';
+
+        return 0;
+    }
+
+    /* return an estimation if no buffer */
+    if (HASHIDS_UNLIKELY(!buffer)) {
+        return hashids_estimate_encoded_size(hashids, numbers_count, numbers);
+    }
+
+    return hashids_encode_prepared(hashids, ctx,
+        hashids_prepare_salt(hashids, ctx), buffer, numbers_count, numbers);
+}
+
+/* encode many (reentrant, status-returning) */
+int
+hashids_encode_s(const hashids_t *hashids, hashids_ctx_t *ctx, char *buffer,
+    size_t numbers_count, const unsigned long long *numbers, size_t *length)
+{
+    *length = 0;
+
+    /* nothing to encode */
+    if (HASHIDS_UNLIKELY(!numbers_count)) {
+        if (buffer) {
+            buffer[0] = '\0';
+        }
+
+        return HASHIDS_ERROR_INVALID_NUMBER;
+    }
+
+    *length = hashids_encode_r(hashids, ctx, buffer, numbers_count, numbers);
+    return HASHIDS_ERROR_OK;
+}
+
+/* encode many groups into one packed buffer */
+size_t
+hashids_encode_batch(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, size_t buffer_size, size_t groups_count,
+    const size_t *numbers_counts, const unsigned long long *numbers,
+    size_t *offsets, size_t *lengths)
+{
+    size_t i, count, offset, bound;
+    unsigned long long max;
+    int p_max;
+
+    /* with single numbers, a worst-case bound saves estimating each one */
+    max = 0xFFFFFFFFFFFFFFFFull;
+    bound = numbers_counts ? (size_t)-1
+        : hashids_estimate_encoded_size(hashids, 1, &max);
+
+    p_max = hashids_prepare_salt(hashids, ctx);
+
+    for (i = 0, offset = 0; i < groups_count; ++i) {
+        count = numbers_counts ? numbers_counts[i] : 1;
+
+        /* stop at the first group that might not fit */
+        if (buffer_size - offset < bound
+            && hashids_estimate_encoded_size(hashids, count, numbers)
+                > buffer_size - offset) {
+            break;
+        }
+
+        offsets[i] = offset;
+        if (HASHIDS_LIKELY(count)) {
+            lengths[i] = hashids_encode_prepared(hashids, ctx, p_max,
+                buffer + offset, count, numbers);
+        } else {
+            buffer[offset] = '\0';
+            lengths[i] = 0;
+        }
+
+        offset += lengths[i] + 1;
+        numbers += count;
+    }
+
+    return i;
+}
+
+/* encode many (generic) */
+size_t
+hashids_encode(hashids_t *hashids, char *buffer,
+    size_t numbers_count, unsigned long long *numbers)
+{
+    hashids_ctx_t ctx;
+
+    return hashids_encode_r(hashids, &ctx, buffer, numbers_count, numbers);
+}
+
+/* encode many (variadic) */
+size_t
+hashids_encode_v(hashids_t *hashids, char *buffer,
+    size_t numbers_count, ...)
+{
+    size_t i, result;
+    unsigned long long *numbers;
+    va_list ap;
+
+    numbers = (unsigned long long *)hashids_instance_alloc(hashids,
+        numbers_count * sizeof(unsigned long long));
+
+    if (HASHIDS_UNLIKELY(!numbers)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return 0;
+    }
+
+    va_start(ap, numbers_count);
+    for (i = 0; i < numbers_count; ++i) {
+        numbers[i] = va_arg(ap, unsigned long long);
+    }
+    va_end(ap);
+
+    result = hashids_encode(hashids, buffer, numbers_count, numbers);
+    hashids_instance_free(hashids, numbers);
+
+    return result;
+}
+
+/* encode one */
+size_t
+hashids_encode_one(hashids_t *hashids, char *buffer,
+    unsigned long long number)
+{
+    return hashids_encode(hashids, buffer, 1, &number);
+}
+
+/* encode one (reentrant) */
+size_t
+hashids_encode_one_r(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, unsigned long long number)
+{
+    return hashids_encode_r(hashids, ctx, buffer, 1, &number);
+}
+
+/* numbers count (status-returning) */
+int
+hashids_numbers_count_s(const hashids_t *hashids, const char *str,
+    size_t *result)
+{
+    size_t numbers_count, len, pos, block, limit;
+    unsigned long long masks[3], region;
+
+    *result = 0;
+    len = strlen(str);
+    pos = hashids_skip_guard(hashids, str, len);
+
+    /* parse: count separators up to the closing guard */
+    numbers_count = 0;
+    for (; pos < len; pos += HASHIDS_SCAN_BLOCK) {
+        block = len - pos < HASHIDS_SCAN_BLOCK ? len - pos : HASHIDS_SCAN_BLOCK;
+        hashids_scan(hashids, str + pos, block, masks);
+
+        limit = masks[2] ? hashids_ctz64(masks[2]) : block;
+        region = hashids_low_bits(limit);
+        if (HASHIDS_UNLIKELY(~(masks[0] | masks[1]) & region)) {
+            return HASHIDS_ERROR_INVALID_HASH;
+        }
+        numbers_count += hashids_popcount64(masks[1] & region);
+
+        if (masks[2]) {
+            break;
+        }
+    }
+
+    /* account for the last number */
+    *result = numbers_count + 1;
+    return HASHIDS_ERROR_OK;
+}
+
+/* numbers count */
+size_t
+hashids_numbers_count(const hashids_t *hashids, const char *str)
+{
+    size_t numbers_count;
+    int status;
+
+    status = hashids_numbers_count_s(hashids, str, &numbers_count);
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK)) {
+        hashids_errno = status;
+    }
+
+    return numbers_count;
+}
+
+/* accumulate a run of alphabet characters into number */
+static inline unsigned long long
+hashids_accumulate(const hashids_t *hashids, const unsigned char *digits,
+    unsigned long long number, const char *str, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; ++i) {
+        number = number * hashids->alphabet_length
+            + digits[hashids->indexes[(unsigned char)str[i]]];
+    }
+
+    return number;
+}
+
+/* internal decode status: numbers_max reached before the end of the hash */
+#define HASHIDS_DECODE_TRUNCATED 1
+
+/* accumulate like hashids_accumulate, flagging results past 64 bits */
+static inline unsigned long long
+hashids_accumulate_checked(const hashids_t *hashids,
+    const unsigned char *digits, unsigned long long number, const char *str,
+    size_t len, int *overflow)
+{
+    unsigned long long limit, digit;
+    size_t i;
+
+    limit = hashids_divide(&hashids->alphabet_divisor, ~0ull);
+    for (i = 0; i < len; ++i) {
+        digit = digits[hashids->indexes[(unsigned char)str[i]]];
+        if (HASHIDS_UNLIKELY(number > limit || (number == limit
+            && digit > ~0ull - limit * hashids->alphabet_length))) {
+            *overflow = 1;
+        }
+        number = number * hashids->alphabet_length + digit;
+    }
+
+    return number;
+}
+
+/* what verification needs to know about a decoded hash */
+struct hashids_decoded_s {
+    size_t start;               /* lottery position */
+    size_t end;                 /* closing guard position (or length) */
+    unsigned long long numbers_hash;
+    const char *alphabet;       /* alphabet of the last number */
+    size_t numbers_count;
+};
+
+/* would encoding the decoded number reproduce this segment exactly? */
+static inline int
+hashids_segment_canonical(const hashids_t *hashids,
+    const unsigned char *digits, const char *segment, size_t length,
+    int overflow)
 {
-    return hashids_init2(salt, HASHIDS_DEFAULT_MIN_HASH_LENGTH);
+    /* no empty segments, no leading zeroes, no wrapped numbers */
+    return length && !overflow && (length == 1
+        || digits[hashids->indexes[(unsigned char)segment[0]]]);
 }
 
-/* estimate buffer size (generic) */
+/* decode a length-bounded hash (verifying canonical segments and
+   separators on the way when decoded is not NULL; a verifying decode goes
+   on past numbers_max, so only a canonical hash is reported truncated) */
+static size_t
+hashids_decode_n(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, size_t len, unsigned long long *numbers,
+    size_t numbers_max, int *status, struct hashids_decoded_s *decoded)
+{
+    struct hashids_body_s body;
+    size_t numbers_count, pos, end, block, cursor, separator, segment;
+    unsigned long long number, masks[3], separators;
+    int overflow, whole;
+    unsigned char lottery_index;
+    const unsigned char *digits, *cached_digits;
+    char lottery;
+    const char *alphabet, *cached;
+    int p_max;
+
+    /* skip characters until we find a guard, and find the closing one */
+    whole = hashids_locate(hashids, str, len, decoded != NULL, &body, masks);
+    pos = body.start;
+    end = body.end;
+
+    /* bail out if there is not even a lottery character; a stray byte is
+       rejected before any shuffle, unless an unsafe decode would stop at
+       numbers_max before reaching it, and a canonical hash can only be
+       padded with alphabet bytes */
+    if (HASHIDS_UNLIKELY(pos == len || (body.invalid
+        && (decoded || body.separators_count < numbers_max))
+        || (decoded && !body.padding))) {
+        *status = HASHIDS_ERROR_INVALID_HASH;
+        return 0;
+    }
+
+    /* get the lottery character */
+    if (decoded) {
+        decoded->start = pos;
+        decoded->end = end;
+        decoded->numbers_hash = 0;
+    }
+    lottery = str[pos++];
+
+    /* alphabet-like buffer used for salt at each iteration */
+    p_max = hashids_prepare_salt(hashids, ctx);
+    ctx->alphabet_copy_2[0] = lottery;
+
+    /* precomputed alphabets for this lottery, if any */
+    lottery_index = hashids->indexes[(unsigned char)lottery];
+    cached = NULL;
+    cached_digits = NULL;
+    if (hashids->shuffles && lottery_index != HASHIDS_INDEX_NONE) {
+        cached = hashids->shuffles + lottery_index * hashids->shuffles_depth
+            * hashids->alphabet_length;
+        cached_digits = hashids->shuffles_digits + lottery_index
+            * hashids->shuffles_depth * hashids->alphabet_length;
+    }
+
+    /* first shuffle */
+    alphabet = hashids->alphabet;
+    digits = hashids_next_digits(hashids, ctx, p_max, &alphabet, cached,
+        cached_digits, 0);
+
+    /* parse block by block, walking the separator mask */
+    numbers_count = 0;
+    number = 0;
+    overflow = 0;
+    segment = pos;
+    for (; pos < end; pos += HASHIDS_SCAN_BLOCK) {
+        block = end - pos < HASHIDS_SCAN_BLOCK ? end - pos : HASHIDS_SCAN_BLOCK;
+        if (whole) {
+            separators = (masks[1] >> pos) & hashids_low_bits(block);
+        } else {
+            hashids_scan(hashids, str + pos, block, masks);
+            separators = masks[1];
+        }
+
+        for (cursor = 0; separators; separators &= separators - 1) {
+            separator = hashids_ctz64(separators);
+
+            if (!decoded) {
+                number = hashids_accumulate(hashids, digits, number,
+                    str + pos + cursor, separator - cursor);
+            } else {
+                number = hashids_accumulate_checked(hashids, digits, number,
+                    str + pos + cursor, separator - cursor, &overflow);
+
+                /* the number and separator must be what encode emits */
+                if (HASHIDS_UNLIKELY(!hashids_segment_canonical(hashids,
+                    digits, str + segment, pos + separator - segment, overflow)
+                    || str[pos + separator] != hashids->separators[(number
+                    % (str[segment] + numbers_count))
+                    % hashids->separators_count])) {
+                    *status = HASHIDS_ERROR_INVALID_HASH;
+                    return 0;
+                }
+                decoded->numbers_hash += number % (numbers_count + 100);
+                segment = pos + separator + 1;
+            }
+
+            /* store the number */
+            if (numbers_count < numbers_max) {
+                numbers[numbers_count] = number;
+            }
+
+            /* check limit */
+            if (++numbers_count >= numbers_max && !decoded) {
+                *status = HASHIDS_DECODE_TRUNCATED;
+                return numbers_count;
+            }
+
+            number = 0;
+            cursor = separator + 1;
+
+            /* resalt the alphabet */
+            digits = hashids_next_digits(hashids, ctx, p_max, &alphabet,
+                cached, cached_digits, numbers_count);
+        }
+
+        if (!decoded) {
+            number = hashids_accumulate(hashids, digits, number,
+                str + pos + cursor, block - cursor);
+        } else {
+            number = hashids_accumulate_checked(hashids, digits, number,
+                str + pos + cursor, block - cursor, &overflow);
+        }
+    }
+
+    /* the last number */
+    if (decoded) {
+        if (HASHIDS_UNLIKELY(!hashids_segment_canonical(hashids, digits,
+            str + segment, end - segment, overflow))) {
+            *status = HASHIDS_ERROR_INVALID_HASH;
+            return 0;
+        }
+        decoded->numbers_hash += number % (numbers_count + 100);
+        decoded->alphabet = alphabet;
+        decoded->numbers_count = numbers_count + 1;
+    }
+
+    /* store last number */
+    if (HASHIDS_UNLIKELY(numbers_count >= numbers_max)) {
+        *status = HASHIDS_DECODE_TRUNCATED;
+        return numbers_max;
+    }
+    numbers[numbers_count] = number;
+
+    *status = HASHIDS_ERROR_OK;
+    return numbers_count + 1;
+}
+
+/* decode (reentrant, status-returning) */
+int
+hashids_decode_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_count)
+{
+    size_t len;
+    int status;
+    HASHIDS_STATS_TIMER(start);
+
+    if (!numbers || !numbers_max) {
+        return hashids_numbers_count_s(hashids, str, numbers_count);
+    }
+
+    len = strlen(str);
+    *numbers_count = hashids_decode_n(hashids, ctx, str, len, numbers,
+        numbers_max, &status, NULL);
+
+    status = status < 0 ? status : HASHIDS_ERROR_OK;
+    HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE, start, len, status);
+
+    return status;
+}
+
+/* decode (reentrant) */
 size_t
-hashids_estimate_encoded_size(hashids_t *hashids,
-    size_t numbers_count, unsigned long long *numbers)
+hashids_decode_r(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max)
+{
+    size_t numbers_count;
+    int status;
+
+    status = hashids_decode_s(hashids, ctx, str, numbers, numbers_max,
+        &numbers_count);
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK)) {
+        hashids_errno = status;
+    }
+
+    return numbers_count;
+}
+
+/* decode */
+size_t
+hashids_decode(hashids_t *hashids, const char *str,
+    unsigned long long *numbers, size_t numbers_max)
+{
+    hashids_ctx_t ctx;
+
+    return hashids_decode_r(hashids, &ctx, str, numbers, numbers_max);
+}
+
+/* decode many hashes from one packed buffer (offsets & lengths) */
+size_t
+hashids_decode_batch(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *buffer, size_t hashes_count, const size_t *offsets,
+    const size_t *lengths, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_counts, int *statuses)
+{
+    size_t i, count, used;
+    int status;
+    HASHIDS_STATS_TIMER(start);
+
+    for (i = 0, used = 0; i < hashes_count && used < numbers_max; ++i) {
+        HASHIDS_STATS_RESTART(start);
+        count = hashids_decode_n(hashids, ctx, buffer + offsets[i], lengths[i],
+            numbers + used, numbers_max - used, &status, NULL);
+
+        /* stop at the first hash whose numbers do not fit */
+        if (HASHIDS_UNLIKELY(status == HASHIDS_DECODE_TRUNCATED)) {
+            break;
+        }
+        HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE, start,
+            lengths[i], status);
+
+        numbers_counts[i] = count;
+        statuses[i] = status;
+        used += count;
+    }
+
+    return i;
+}
+
+/* decode many hashes from one delimiter-separated buffer */
+size_t
+hashids_decode_batch_delimited(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *buffer, size_t buffer_size, char delimiter, size_t hashes_max,
+    unsigned long long *numbers, size_t numbers_max, size_t *numbers_counts,
+    int *statuses, size_t *consumed)
+{
+    size_t i, count, used, offset, len;
+    const char *q;
+    int status;
+    HASHIDS_STATS_TIMER(start);
+
+    for (i = 0, used = 0, offset = 0;
+        i < hashes_max && used < numbers_max && offset < buffer_size; ++i) {
+        HASHIDS_STATS_RESTART(start);
+        q = (const char *)memchr(buffer + offset, delimiter,
+            buffer_size - offset);
+        len = q ? (size_t)(q - buffer - offset) : buffer_size - offset;
+
+        count = hashids_decode_n(hashids, ctx, buffer + offset, len,
+            numbers + used, numbers_max - used, &status, NULL);
+
+        /* stop at the first hash whose numbers do not fit */
+        if (HASHIDS_UNLIKELY(status == HASHIDS_DECODE_TRUNCATED)) {
+            break;
+        }
+        HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE, start, len,
+            status);
+
+        numbers_counts[i] = count;
+        statuses[i] = status;
+        used += count;
+        offset += len + !!q;
+    }
+
+    *consumed = offset;
+    return i;
+}
+
+/* unsafe decode */
+size_t
+hashids_decode_unsafe(hashids_t *hashids, const char *str,
+    unsigned long long *numbers)
+{
+    return hashids_decode(hashids, str, numbers, (size_t)-1);
+}
+
+/* check lottery, guards & padding of a decoded hash against the layout
+   encode would produce, bailing out at the first mismatch */
+static int
+hashids_verify_layout(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, size_t len, const struct hashids_decoded_s *decoded)
+{
+    size_t core, offset, result_len, l, r, i, k;
+    const char *rows, *pad;
+    char padding_salt[HASHIDS_MAX_ALPHABET_LENGTH + 1];
+    char lottery;
+
+    /* lottery */
+    lottery = str[decoded->start];
+    if (lottery != hashids->alphabet[decoded->numbers_hash
+        % hashids->alphabet_length]) {
+        return 0;
+    }
+
+    /* no guards when the intermediate string is long enough */
+    core = decoded->end - decoded->start;
+    if (core >= hashids->min_hash_length) {
+        return decoded->start == 0 && decoded->end == len;
+    }
+
+    /* where the guards and padding go */
+    result_len = hashids_layout(hashids, core, &offset);
+    if (len != result_len || decoded->start != offset) {
+        return 0;
+    }
+
+    /* guard before the encoded numbers */
+    if (str[offset - 1] != hashids->guards[(decoded->numbers_hash + lottery)
+        % hashids->guards_count]) {
+        return 0;
+    }
+    if (core + 1 >= hashids->min_hash_length) {
+        return 1;
+    }
+
+    /* guard after the encoded numbers */
+    if (str[decoded->end] != hashids->guards[(decoded->numbers_hash
+        + str[decoded->start + 1]) % hashids->guards_count]) {
+        return 0;
+    }
+
+    /* padding, grown outwards one round at a time (cached, or one
+       shuffle each) */
+    rows = hashids_padding_rows(hashids, lottery, decoded->numbers_count);
+    if (!rows && decoded->alphabet != ctx->alphabet_copy_1) {
+        memcpy(ctx->alphabet_copy_1, decoded->alphabet,
+            hashids->alphabet_length);
+    }
+    for (i = offset - 1, k = decoded->end + 1, result_len = core + 2;
+        result_len < hashids->min_hash_length; ) {
+        if (rows) {
+            pad = rows;
+            rows += hashids->alphabet_length;
+        } else {
+            memcpy(padding_salt, ctx->alphabet_copy_1,
+                hashids->alphabet_length);
+            hashids_shuffle(ctx->alphabet_copy_1, hashids->alphabet_length,
+                padding_salt, hashids->alphabet_length);
+            HASHIDS_STATS_ADD(hashids, shuffles, 1);
+            pad = ctx->alphabet_copy_1;
+        }
+        HASHIDS_STATS_ADD(hashids, padding_iterations, 1);
+
+        hashids_padding(hashids, result_len, &l, &r);
+        if (memcmp(str + i - l, pad + hashids->alphabet_length - l, l)
+            || memcmp(str + k, pad, r)) {
+            return 0;
+        }
+
+        i -= l;
+        k += r;
+        result_len += l + r;
+    }
+
+    return 1;
+}
+
+/* safe decode of a length-bounded hash (a canonical hash of more than
+   numbers_max numbers is reported as truncated, anything else that does
+   not re-encode to the same string as invalid) */
+static int
+hashids_decode_safe_n(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, size_t len, unsigned long long *numbers,
+    size_t numbers_max, size_t *numbers_count)
+{
+    struct hashids_decoded_s decoded;
+    int status;
+
+    *numbers_count = hashids_decode_n(hashids, ctx, str, len, numbers,
+        numbers_max, &status, &decoded);
+
+    if (HASHIDS_UNLIKELY(status == HASHIDS_ERROR_INVALID_HASH
+        || !hashids_verify_layout(hashids, ctx, str, len, &decoded))) {
+        *numbers_count = 0;
+        return HASHIDS_ERROR_INVALID_HASH;
+    }
+    if (HASHIDS_UNLIKELY(status == HASHIDS_DECODE_TRUNCATED)) {
+        *numbers_count = 0;
+        return status;
+    }
+
+    return HASHIDS_ERROR_OK;
+}
+
+/* safe decode (reentrant, status-returning): decode, and accept only the
+   exact string encode would produce for the result (no allocation, no
+   re-encode) */
+int
+hashids_decode_safe_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_count)
+{
+    size_t len;
+    int status;
+    HASHIDS_STATS_TIMER(start);
+
+    *numbers_count = 0;
+    if (HASHIDS_UNLIKELY(!numbers || !numbers_max)) {
+        return HASHIDS_ERROR_INVALID_HASH;
+    }
+
+    len = strlen(str);
+    status = hashids_decode_safe_n(hashids, ctx, str, len, numbers,
+        numbers_max, numbers_count) != HASHIDS_ERROR_OK
+        ? HASHIDS_ERROR_INVALID_HASH : HASHIDS_ERROR_OK;
+    HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE_SAFE, start, len,
+        status);
+
+    return status;
+}
+
+/* safe decode of many hashes from one packed buffer (offsets & lengths);
+   rejected hashes get a status and no numbers */
+size_t
+hashids_decode_safe_batch(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *buffer, size_t hashes_count, const size_t *offsets,
+    const size_t *lengths, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_counts, int *statuses)
+{
+    size_t i, count, used;
+    int status;
+    HASHIDS_STATS_TIMER(start);
+
+    for (i = 0, used = 0; i < hashes_count && used < numbers_max; ++i) {
+        HASHIDS_STATS_RESTART(start);
+        status = hashids_decode_safe_n(hashids, ctx, buffer + offsets[i],
+            lengths[i], numbers + used, numbers_max - used, &count);
+
+        /* stop at the first hash whose numbers do not fit */
+        if (HASHIDS_UNLIKELY(status == HASHIDS_DECODE_TRUNCATED)) {
+            break;
+        }
+        HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE_SAFE, start,
+            lengths[i], status);
+
+        numbers_counts[i] = count;
+        statuses[i] = status;
+        used += count;
+    }
+
+    return i;
+}
+
+/* safe decode (reentrant) */
+size_t
+hashids_decode_safe_r(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max)
+{
+    size_t numbers_count;
+    int status;
+
+    status = hashids_decode_safe_s(hashids, ctx, str, numbers, numbers_max,
+        &numbers_count);
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK)) {
+        hashids_errno = status;
+    }
+
+    return numbers_count;
+}
+
+/* safe decode */
+size_t
+hashids_decode_safe(hashids_t *hashids, const char *str,
+    unsigned long long *numbers, size_t numbers_max)
+{
+    hashids_ctx_t ctx;
+
+    return hashids_decode_safe_r(hashids, &ctx, str, numbers, numbers_max);
+}
+
+/* decode cache geometry: 4-way buckets, at most 64 lock shards */
+#define HASHIDS_DECODE_CACHE_WAYS 4
+#define HASHIDS_DECODE_CACHE_SHARDS 64
+
+/* a cached hash: its numbers, or numbers_count -1 when it is invalid */
+struct hashids_decode_cache_entry_s {
+    unsigned long long numbers[HASHIDS_DECODE_CACHE_NUMBERS];
+    unsigned char length;
+    signed char numbers_count;
+    char key[HASHIDS_DECODE_CACHE_KEY_MAX];
+};
+
+/* one set: tags (key hash | 1, 0 when empty) up front, CLOCK bits */
+struct hashids_decode_cache_bucket_s {
+    unsigned long long tags[HASHIDS_DECODE_CACHE_WAYS];
+    unsigned char referenced;
+    unsigned char hand;
+    struct hashids_decode_cache_entry_s
+        entries[HASHIDS_DECODE_CACHE_WAYS];
+};
+
+/* a lock and the counters it guards, one cache line each */
+struct hashids_decode_cache_shard_s {
+    hashids_lock_t lock;
+    hashids_decode_cache_stats_t stats;
+} HASHIDS_ALIGNED(HASHIDS_CACHE_LINE);
+
+struct hashids_decode_cache_s {
+    const hashids_t *hashids;
+    struct hashids_decode_cache_bucket_s *buckets;
+    size_t buckets_mask;
+    struct hashids_decode_cache_shard_s *shards;
+    size_t shards_count;
+    void *block;
+};
+
+/* key hash (64-bit words, FNV-style mixing) */
+static inline unsigned long long
+hashids_decode_cache_hash(const char *str, size_t len)
+{
+    const unsigned char *p;
+    unsigned long long hash;
+
+    p = (const unsigned char *)str;
+    for (hash = 0xCBF29CE484222325ull ^ len; len >= 8; p += 8, len -= 8) {
+        hash = (hash ^ hashids_get_le64(p)) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+    }
+    hash = (hash ^ hashids_get_le(p, len)) * 0x100000001B3ull;
+    hash ^= hash >> 32;
+
+    return hash | 1;
+}
+
+/* create a decode cache of about `capacity` hashes over an instance (the
+   instance must outlive it and not change) */
+hashids_decode_cache_t *
+hashids_decode_cache_create(const hashids_t *hashids, size_t capacity)
+{
+    hashids_decode_cache_t *cache;
+    size_t buckets_count, shards_count, size, i;
+    char *block;
+
+    hashids_errno = HASHIDS_ERROR_OK;
+
+    for (buckets_count = 1;
+        buckets_count * HASHIDS_DECODE_CACHE_WAYS < capacity;
+        buckets_count *= 2) {
+        if (HASHIDS_UNLIKELY(buckets_count > (size_t)-1 / 4
+            / sizeof(struct hashids_decode_cache_bucket_s))) {
+            hashids_errno = HASHIDS_ERROR_ALLOC;
+            return NULL;
+        }
+    }
+    shards_count = buckets_count < HASHIDS_DECODE_CACHE_SHARDS
+        ? buckets_count : HASHIDS_DECODE_CACHE_SHARDS;
+
+    /* one block: cache, shards, buckets (aligned by hand) */
+    size = sizeof(hashids_decode_cache_t) + HASHIDS_CACHE_LINE - 1
+        + shards_count * sizeof(struct hashids_decode_cache_shard_s)
+        + buckets_count * sizeof(struct hashids_decode_cache_bucket_s);
+    block = (char *)hashids_instance_alloc(hashids, size);
+    if (HASHIDS_UNLIKELY(!block)) {
+        hashids_errno = HASHIDS_ERROR_ALLOC;
+        return NULL;
+    }
+
+    cache = (hashids_decode_cache_t *)block;
+    cache->block = block;
+    cache->hashids = hashids;
+    cache->shards = (struct hashids_decode_cache_shard_s *)(block
+        + sizeof(hashids_decode_cache_t) + (HASHIDS_CACHE_LINE
+        - (size_t)(block + sizeof(hashids_decode_cache_t))
+        % HASHIDS_CACHE_LINE) % HASHIDS_CACHE_LINE);
+    cache->shards_count = shards_count;
+    cache->buckets = (struct hashids_decode_cache_bucket_s *)
+        (cache->shards + shards_count);
+    cache->buckets_mask = buckets_count - 1;
+
+    for (i = 0; i < shards_count; ++i) {
+        hashids_lock_init(&cache->shards[i].lock);
+    }
+
+    return cache;
+}
+
+/* free a decode cache */
+void
+hashids_decode_cache_free(hashids_decode_cache_t *cache)
+{
+    size_t i;
+
+    if (cache) {
+        for (i = 0; i < cache->shards_count; ++i) {
+            hashids_lock_destroy(&cache->shards[i].lock);
+        }
+        hashids_instance_free(cache->hashids, cache->block);
+    }
+}
+
+/* the way holding a key, or -1 (with the shard locked) */
+static inline int
+hashids_decode_cache_find(
+    const struct hashids_decode_cache_bucket_s *bucket,
+    unsigned long long tag, const char *str, size_t len)
+{
+    int way;
+
+    for (way = 0; way < HASHIDS_DECODE_CACHE_WAYS; ++way) {
+        if (bucket->tags[way] == tag && bucket->entries[way].length == len
+            && !memcmp(bucket->entries[way].key, str, len)) {
+            return way;
+        }
+    }
+
+    return -1;
+}
+
+/* safe decode through the cache: same results as hashids_decode_safe_s,
+   with verified and rejected hashes remembered */
+int
+hashids_decode_cached_s(hashids_decode_cache_t *cache, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_count)
+{
+    struct hashids_decode_cache_bucket_s *bucket;
+    struct hashids_decode_cache_shard_s *shard;
+    struct hashids_decode_cache_entry_s *entry;
+    unsigned long long tag, decoded[HASHIDS_DECODE_CACHE_NUMBERS];
+    size_t len, count, bucket_index;
+    int way, status;
+    HASHIDS_STATS_TIMER(start);
+
+    *numbers_count = 0;
+    if (HASHIDS_UNLIKELY(!numbers || !numbers_max)) {
+        return HASHIDS_ERROR_INVALID_HASH;
+    }
+
+    /* hashes too long to keep go straight through */
+    len = strlen(str);
+    if (HASHIDS_UNLIKELY(!len || len > HASHIDS_DECODE_CACHE_KEY_MAX)) {
+        return hashids_decode_safe_s(cache->hashids, ctx, str, numbers,
+            numbers_max, numbers_count);
+    }
+
+    tag = hashids_decode_cache_hash(str, len);
+    bucket_index = (size_t)(tag >> 1) & cache->buckets_mask;
+    bucket = &cache->buckets[bucket_index];
+    shard = &cache->shards[bucket_index % cache->shards_count];
+
+    /* lookup */
+    hashids_lock(&shard->lock);
+    way = hashids_decode_cache_find(bucket, tag, str, len);
+    if (way >= 0) {
+        entry = &bucket->entries[way];
+        bucket->referenced |= (unsigned char)(1u << way);
+        ++shard->stats.hits;
+
+        if (entry->numbers_count < 0) {
+            ++shard->stats.negative_hits;
+            status = HASHIDS_ERROR_INVALID_HASH;
+        } else if ((size_t)entry->numbers_count > numbers_max) {
+            /* like a truncated safe decode */
+            status = HASHIDS_ERROR_INVALID_HASH;
+        } else {
+            memcpy(numbers, entry->numbers,
+                entry->numbers_count * sizeof(unsigned long long));
+            *numbers_count = entry->numbers_count;
+            status = HASHIDS_ERROR_OK;
+        }
+
+        hashids_unlock(&shard->lock);
+        return status;
+    }
+    ++shard->stats.misses;
+    hashids_unlock(&shard->lock);
+
+    /* decode outside the lock; hashes with more numbers than an entry
+       holds are not kept */
+    status = hashids_decode_safe_n(cache->hashids, ctx, str, len, decoded,
+        HASHIDS_DECODE_CACHE_NUMBERS, &count);
+    if (status == HASHIDS_DECODE_TRUNCATED) {
+        return hashids_decode_safe_s(cache->hashids, ctx, str, numbers,
+            numbers_max, numbers_count);
+    }
+    HASHIDS_STATS_RECORD(cache->hashids, HASHIDS_STATS_DECODE_SAFE, start,
+        len, status);
+
+    /* insert (unless another thread already did), evicting by CLOCK */
+    hashids_lock(&shard->lock);
+    if (hashids_decode_cache_find(bucket, tag, str, len) < 0) {
+        for (way = 0; way < HASHIDS_DECODE_CACHE_WAYS && bucket->tags[way];
+            ++way) {
+            /* empty */
+        }
+        if (way == HASHIDS_DECODE_CACHE_WAYS) {
+            while (bucket->referenced & (1u << bucket->hand)) {
+                bucket->referenced &= (unsigned char)~(1u << bucket->hand);
+                bucket->hand = (bucket->hand + 1)
+                    % HASHIDS_DECODE_CACHE_WAYS;
+            }
+            way = bucket->hand;
+            bucket->hand = (bucket->hand + 1) % HASHIDS_DECODE_CACHE_WAYS;
+            ++shard->stats.evictions;
+        }
+
+        entry = &bucket->entries[way];
+        bucket->tags[way] = tag;
+        bucket->referenced &= (unsigned char)~(1u << way);
+        entry->length = (unsigned char)len;
+        memcpy(entry->key, str, len);
+        if (status == HASHIDS_ERROR_OK) {
+            entry->numbers_count = (signed char)count;
+            memcpy(entry->numbers, decoded, count * sizeof(*decoded));
+        } else {
+            entry->numbers_count = -1;
+        }
+    }
+    hashids_unlock(&shard->lock);
+
+    if (status != HASHIDS_ERROR_OK || count > numbers_max) {
+        return HASHIDS_ERROR_INVALID_HASH;
+    }
+    memcpy(numbers, decoded, count * sizeof(*decoded));
+    *numbers_count = count;
+    return HASHIDS_ERROR_OK;
+}
+
+/* sum the per-shard counters */
+void
+hashids_decode_cache_stats(hashids_decode_cache_t *cache,
+    hashids_decode_cache_stats_t *stats)
+{
+    size_t i;
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < cache->shards_count; ++i) {
+        hashids_lock(&cache->shards[i].lock);
+        stats->hits += cache->shards[i].stats.hits;
+        stats->negative_hits += cache->shards[i].stats.negative_hits;
+        stats->misses += cache->shards[i].stats.misses;
+        stats->evictions += cache->shards[i].stats.evictions;
+        hashids_unlock(&cache->shards[i].lock);
+    }
+}
+
+#ifdef HASHIDS_HAVE_INT128
+/* floor(log2(x)) for x != 0 */
+static inline unsigned short
+hashids_log2_128(hashids_uint128_t x)
+{
+    return x >> 64 ? 64 + hashids_log2_64((unsigned long long)(x >> 64))
+        : hashids_log2_64((unsigned long long)x);
+}
+
+/* estimate buffer size (128-bit numbers) */
+size_t
+hashids_estimate_encoded_size128(const hashids_t *hashids,
+    size_t numbers_count, const hashids_uint128_t *numbers)
 {
     size_t i, result_len;
 
     for (i = 0, result_len = 1; i < numbers_count; ++i) {
         if (numbers[i] == 0) {
-            result_len += 2;
-        } else if (numbers[i] == 0xFFFFFFFFFFFFFFFFull) {
-            result_len += hashids_div_ceil_unsigned_short(
-                hashids_log2_64(numbers[i]),
-                hashids_log2_64(hashids->alphabet_length)) - 1;
+            result_len += 1;
         } else {
+            /* bit length over floor(log2(alphabet_length)) never undershoots */
             result_len += hashids_div_ceil_unsigned_short(
-                hashids_log2_64(numbers[i] + 1),
+                hashids_log2_128(numbers[i]) + 1,
                 hashids_log2_64(hashids->alphabet_length));
         }
     }
@@ -433,497 +3130,570 @@ hashids_estimate_encoded_size(hashids_t *hashids,
         result_len = hashids->min_hash_length;
     }
 
-    return result_len + 2 /* fast log2 & ceil sometimes undershoot by 1 */;
+    return result_len + 1 /* terminating NUL */;
 }
 
-/* estimate buffer size (variadic) */
-size_t
-hashids_estimate_encoded_size_v(hashids_t *hashids,
-    size_t numbers_count, ...)
+/* digits of a 128-bit number: full groups of the largest power that fits
+   64 bits, then the rest */
+static inline size_t
+hashids_digits_count128(const hashids_t *hashids, hashids_uint128_t number)
 {
-    size_t i, result;
-    unsigned long long *numbers;
-    va_list ap;
+    size_t digits;
+    unsigned long long power;
 
-    numbers = (unsigned long long *)_hashids_alloc(numbers_count *
-        sizeof(unsigned long long));
+    power = hashids->alphabet_powers[hashids->alphabet_powers_count - 1];
+    for (digits = 0; number >> 64; number /= power) {
+        digits += hashids->alphabet_powers_count;
+    }
 
-    if (HASHIDS_UNLIKELY(!numbers)) {
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return 0;
+    return digits + hashids_digits_count(hashids, (unsigned long long)number);
+}
+
+/* encode many 128-bit numbers; numbers below 2^64 hash exactly as with
+   hashids_encode */
+static size_t
+hashids_encode128_prepared(const hashids_t *hashids, hashids_ctx_t *ctx,
+    int p_max, char *buffer, size_t numbers_count,
+    const hashids_uint128_t *numbers)
+{
+    size_t i, j, core_len, offset, result_len;
+    hashids_uint128_t number, quotient128;
+    unsigned long long numbers_hash, power, low, quotient;
+    const char *alphabet, *cached;
+    char lottery, *p, *q, *segment_end;
+    HASHIDS_STATS_TIMER(start);
+
+    /* wide numbers are cut into groups of the largest power of the
+       alphabet length that fits 64 bits */
+    power = hashids->alphabet_powers[hashids->alphabet_powers_count - 1];
+
+    for (i = 0, numbers_hash = 0, core_len = numbers_count;
+        i < numbers_count; ++i) {
+        numbers_hash += (unsigned long long)(numbers[i] % (i + 100));
+        core_len += hashids_digits_count128(hashids, numbers[i]);
     }
+    result_len = hashids_layout(hashids, core_len, &offset);
 
-    va_start(ap, numbers_count);
-    for (i = 0; i < numbers_count; ++i) {
-        numbers[i] = va_arg(ap, unsigned long long);
+    lottery = hashids->alphabet[numbers_hash % hashids->alphabet_length];
+    p = buffer + offset;
+    *p++ = lottery;
+    ctx->alphabet_copy_2[0] = lottery;
+
+    cached = hashids->shuffles ? hashids->shuffles
+        + (numbers_hash % hashids->alphabet_length) * hashids->shuffles_depth
+        * hashids->alphabet_length : NULL;
+
+    for (i = 0, alphabet = hashids->alphabet; i < numbers_count; ++i) {
+        number = numbers[i];
+        alphabet = hashids_next_alphabet(hashids, ctx, p_max, alphabet, cached,
+            i);
+
+        /* from the last digit back: full 64-bit groups, then the rest */
+        segment_end = q = p + hashids_digits_count128(hashids, number);
+        while (number >> 64) {
+            quotient128 = number / power;
+            low = (unsigned long long)(number - quotient128 * power);
+            for (j = 0; j < hashids->alphabet_powers_count; ++j) {
+                quotient = hashids_divide(&hashids->alphabet_divisor, low);
+                *--q = alphabet[low - quotient * hashids->alphabet_length];
+                low = quotient;
+            }
+            number = quotient128;
+        }
+        low = (unsigned long long)number;
+        do {
+            quotient = hashids_divide(&hashids->alphabet_divisor, low);
+            *--q = alphabet[low - quotient * hashids->alphabet_length];
+            low = quotient;
+        } while (low);
+
+        if (i + 1 < numbers_count) {
+            *segment_end = hashids->separators[(unsigned long long)(numbers[i]
+                % (size_t)(*p + i)) % hashids->separators_count];
+            p = segment_end + 1;
+        }
     }
-    va_end(ap);
 
-    result = hashids_estimate_encoded_size(hashids, numbers_count, numbers);
-    _hashids_free(numbers);
+    i = hashids_encode_finish(hashids, ctx, buffer, offset, core_len,
+        result_len, numbers_hash, numbers_count, alphabet);
+    HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_ENCODE, start, i,
+        HASHIDS_ERROR_OK);
 
-    return result;
+    return i;
 }
 
-/* encode many (generic) */
-size_t
-hashids_encode(hashids_t *hashids, char *buffer,
-    size_t numbers_count, unsigned long long *numbers)
+/* encode many 128-bit numbers (reentrant, status-returning) */
+int
+hashids_encode128_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, size_t numbers_count, const hashids_uint128_t *numbers,
+    size_t *length)
 {
-    /* bail out if no numbers */
+    *length = 0;
+
+    /* nothing to encode */
     if (HASHIDS_UNLIKELY(!numbers_count)) {
-        buffer[0] = '\0';
+        if (buffer) {
+            buffer[0] = '\0';
+        }
 
-        return 0;
+        return HASHIDS_ERROR_INVALID_NUMBER;
     }
 
-    size_t i, j, result_len, guard_index, half_length_ceil, half_length_floor;
-    unsigned long long number, number_copy, numbers_hash;
-    int p_max;
-    char lottery, ch, temp_ch, *p, *buffer_end, *buffer_temp;
-
     /* return an estimation if no buffer */
     if (HASHIDS_UNLIKELY(!buffer)) {
-        return hashids_estimate_encoded_size(hashids, numbers_count, numbers);
+        *length = hashids_estimate_encoded_size128(hashids, numbers_count,
+            numbers);
+        return HASHIDS_ERROR_OK;
     }
 
-    /* copy the alphabet into internal buffer 1 */
-    strncpy(hashids->alphabet_copy_1, hashids->alphabet,
-        hashids->alphabet_length);
-
-    /* walk arguments once and generate a hash */
-    for (i = 0, numbers_hash = 0; i < numbers_count; ++i) {
-        number = numbers[i];
-        numbers_hash += number % (i + 100);
-    }
+    *length = hashids_encode128_prepared(hashids, ctx,
+        hashids_prepare_salt(hashids, ctx), buffer, numbers_count, numbers);
+    return HASHIDS_ERROR_OK;
+}
 
-    /* lottery character */
-    lottery = hashids->alphabet[numbers_hash % hashids->alphabet_length];
+/* decode a length-bounded hash into 128-bit numbers, rejecting numbers
+   that do not fit (and, when decoded is not NULL, verifying canonical
+   segments and separators like hashids_decode_n) */
+static size_t
+hashids_decode128_n(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, size_t len, hashids_uint128_t *numbers,
+    size_t numbers_max, int *status, struct hashids_decoded_s *decoded)
+{
+    struct hashids_body_s body;
+    size_t numbers_count, pos, end, segment;
+    unsigned long long masks[3];
+    hashids_uint128_t number, limit;
+    unsigned char ch, lottery_index, digit;
+    const unsigned char *digits, *cached_digits;
+    const char *alphabet, *cached;
+    int p_max;
 
-    /* start output buffer with it (or don't) */
-    buffer[0] = lottery;
-    buffer_end = buffer + 1;
+    hashids_locate(hashids, str, len, decoded != NULL, &body, masks);
+    pos = body.start;
+    end = body.end;
+    if (HASHIDS_UNLIKELY(pos == len || (body.invalid
+        && (decoded || body.separators_count < numbers_max))
+        || (decoded && !body.padding))) {
+        *status = HASHIDS_ERROR_INVALID_HASH;
+        return 0;
+    }
 
-    /* alphabet-like buffer used for salt at each iteration */
-    hashids->alphabet_copy_2[0] = lottery;
-    hashids->alphabet_copy_2[1] = '\0';
-    strncat(hashids->alphabet_copy_2, hashids->salt,
-        hashids->alphabet_length - 1);
-    p = hashids->alphabet_copy_2 + hashids->salt_length + 1;
-    p_max = (int)(hashids->alphabet_length - 1 - hashids->salt_length);
-    if (p_max > 0) {
-        strncat(hashids->alphabet_copy_2, hashids->alphabet,
-            p_max);
-    } else {
-        hashids->alphabet_copy_2[hashids->alphabet_length] = '\0';
+    if (decoded) {
+        decoded->start = pos;
+        decoded->end = end;
+        decoded->numbers_hash = 0;
     }
 
-    for (i = 0; i < numbers_count; ++i) {
-        /* take number */
-        number = number_copy = numbers[i];
+    p_max = hashids_prepare_salt(hashids, ctx);
+    ctx->alphabet_copy_2[0] = str[pos];
+
+    lottery_index = hashids->indexes[(unsigned char)str[pos++]];
+    cached = NULL;
+    cached_digits = NULL;
+    if (hashids->shuffles && lottery_index != HASHIDS_INDEX_NONE) {
+        cached = hashids->shuffles + lottery_index * hashids->shuffles_depth
+            * hashids->alphabet_length;
+        cached_digits = hashids->shuffles_digits + lottery_index
+            * hashids->shuffles_depth * hashids->alphabet_length;
+    }
 
-        /* create a salt for this iteration */
-        if (p_max > 0) {
-            strncpy(p, hashids->alphabet_copy_1, p_max);
-        }
+    alphabet = hashids->alphabet;
+    digits = hashids_next_digits(hashids, ctx, p_max, &alphabet, cached,
+        cached_digits, 0);
 
-        /* shuffle the alphabet */
-        hashids_shuffle(hashids->alphabet_copy_1, hashids->alphabet_length,
-            hashids->alphabet_copy_2, hashids->alphabet_length);
+    /* numbers above limit overflow with the next digit */
+    limit = ~(hashids_uint128_t)0 / hashids->alphabet_length;
 
-        /* hash the number */
-        buffer_temp = buffer_end;
-        do {
-            ch = hashids->alphabet_copy_1[number % hashids->alphabet_length];
-            *buffer_end++ = ch;
-            number /= hashids->alphabet_length;
-        } while (number);
+    numbers_count = 0;
+    number = 0;
+    /* only alphabet bytes & separators come before end */
+    for (segment = pos; pos < end; ++pos) {
+        ch = (unsigned char)str[pos];
+
+        if (hashids->classes[ch] == HASHIDS_CLASS_ALPHABET) {
+            digit = digits[hashids->indexes[ch]];
+            if (HASHIDS_UNLIKELY(number > limit || (number == limit
+                && digit > ~(hashids_uint128_t)0 - limit
+                    * hashids->alphabet_length))) {
+                *status = HASHIDS_ERROR_INVALID_HASH;
+                return 0;
+            }
+            number = number * hashids->alphabet_length + digit;
+            continue;
+        }
 
-        /* reverse the hash we got */
-        for (j = 0; j < (size_t)((buffer_end - buffer_temp) / 2); ++j) {
-            temp_ch = *(buffer_temp + j);
-            *(buffer_temp + j) = *(buffer_end - 1 - j);
-            *(buffer_end - 1 - j) = temp_ch;
+        if (decoded) {
+            /* the number and separator must be what encode emits */
+            if (HASHIDS_UNLIKELY(!hashids_segment_canonical(hashids,
+                digits, str + segment, pos - segment, 0)
+                || ch != (unsigned char)hashids->separators[
+                    (unsigned long long)(number % (size_t)(
+                    str[segment] + numbers_count))
+                    % hashids->separators_count])) {
+                *status = HASHIDS_ERROR_INVALID_HASH;
+                return 0;
+            }
+            decoded->numbers_hash += (unsigned long long)(number
+                % (numbers_count + 100));
+            segment = pos + 1;
         }
 
-        if (i + 1 < numbers_count) {
-            number_copy %= ch + i;
-            *buffer_end = hashids->separators[number_copy %
-                hashids->separators_count];
-            ++buffer_end;
+        *numbers++ = number;
+        if (++numbers_count >= numbers_max) {
+            *status = HASHIDS_DECODE_TRUNCATED;
+            return numbers_count;
         }
-    }
 
-    /* intermediate string length */
-    result_len = buffer_end - buffer;
+        number = 0;
+        digits = hashids_next_digits(hashids, ctx, p_max, &alphabet,
+            cached, cached_digits, numbers_count);
+    }
 
-    if (result_len < hashids->min_hash_length) {
-        /* add a guard before the encoded numbers */
-        guard_index = (numbers_hash + buffer[0]) % hashids->guards_count;
-        memmove(buffer + 1, buffer, result_len);
-        buffer[0] = hashids->guards[guard_index];
-        ++result_len;
+    /* the last number */
+    if (decoded) {
+        if (HASHIDS_UNLIKELY(!hashids_segment_canonical(hashids, digits,
+            str + segment, end - segment, 0))) {
+            *status = HASHIDS_ERROR_INVALID_HASH;
+            return 0;
+        }
+        decoded->numbers_hash += (unsigned long long)(number
+            % (numbers_count + 100));
+        decoded->alphabet = alphabet;
+        decoded->numbers_count = numbers_count + 1;
+    }
 
-        if (result_len < hashids->min_hash_length) {
-            /* add a guard after the encoded numbers */
-            guard_index = (numbers_hash + buffer[2]) % hashids->guards_count;
-            buffer[result_len] = hashids->guards[guard_index];
-            ++result_len;
-
-            /* pad with half alphabet before and after */
-            half_length_ceil = hashids_div_ceil_size_t(
-                hashids->alphabet_length, 2);
-            half_length_floor = floor((float)hashids->alphabet_length / 2);
-
-            /* pad, pad, pad */
-            while (result_len < hashids->min_hash_length) {
-                /* shuffle the alphabet */
-                strncpy(hashids->alphabet_copy_2, hashids->alphabet_copy_1,
-                    hashids->alphabet_length);
-                hashids_shuffle(hashids->alphabet_copy_1,
-                    hashids->alphabet_length, hashids->alphabet_copy_2,
-                    hashids->alphabet_length);
+    *numbers = number;
 
-                /* left pad from the end of the alphabet */
-                i = hashids_div_ceil_size_t(
-                    hashids->min_hash_length - result_len, 2);
-                /* right pad from the beginning */
-                j = floor((float)(hashids->min_hash_length - result_len) / 2);
+    *status = HASHIDS_ERROR_OK;
+    return numbers_count + 1;
+}
 
-                /* check bounds */
-                if (i > half_length_ceil) {
-                    i = half_length_ceil;
-                }
-                if (j > half_length_floor) {
-                    j = half_length_floor;
-                }
+/* decode into 128-bit numbers (reentrant, status-returning) */
+int
+hashids_decode128_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, hashids_uint128_t *numbers, size_t numbers_max,
+    size_t *numbers_count)
+{
+    size_t len;
+    int status;
+    HASHIDS_STATS_TIMER(start);
 
-                /* handle excessively excessive excess */
-                if ((i + j) % 2 == 0 && hashids->alphabet_length % 2 == 1) {
-                    ++i; --j;
-                }
+    if (!numbers || !numbers_max) {
+        return hashids_numbers_count_s(hashids, str, numbers_count);
+    }
 
-                /* move the current result to "center" */
-                memmove(buffer + i, buffer, result_len);
-                /* pad left */
-                memmove(buffer,
-                    hashids->alphabet_copy_1 + hashids->alphabet_length - i, i);
-                /* pad right */
-                memmove(buffer + i + result_len, hashids->alphabet_copy_1, j);
+    len = strlen(str);
+    *numbers_count = hashids_decode128_n(hashids, ctx, str, len, numbers,
+        numbers_max, &status, NULL);
 
-                /* increment result_len */
-                result_len += i + j;
-            }
-        }
-    }
+    status = status < 0 ? status : HASHIDS_ERROR_OK;
+    HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE, start, len, status);
 
-    buffer[result_len] = '\0';
-    return result_len;
+    return status;
 }
 
-/* encode many (variadic) */
-size_t
-hashids_encode_v(hashids_t *hashids, char *buffer,
-    size_t numbers_count, ...)
+/* safe decode into 128-bit numbers (reentrant, status-returning) */
+int
+hashids_decode_safe128_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, hashids_uint128_t *numbers, size_t numbers_max,
+    size_t *numbers_count)
 {
-    size_t i, result;
-    unsigned long long *numbers;
-    va_list ap;
-
-    numbers = (unsigned long long *)_hashids_alloc(numbers_count *
-        sizeof(unsigned long long));
+    struct hashids_decoded_s decoded;
+    size_t len;
+    int status;
+    HASHIDS_STATS_TIMER(start);
 
-    if (HASHIDS_UNLIKELY(!numbers)) {
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return 0;
+    *numbers_count = 0;
+    if (HASHIDS_UNLIKELY(!numbers || !numbers_max)) {
+        return HASHIDS_ERROR_INVALID_HASH;
     }
 
-    va_start(ap, numbers_count);
-    for (i = 0; i < numbers_count; ++i) {
-        numbers[i] = va_arg(ap, unsigned long long);
-    }
-    va_end(ap);
+    len = strlen(str);
+    *numbers_count = hashids_decode128_n(hashids, ctx, str, len, numbers,
+        numbers_max, &status, &decoded);
 
-    result = hashids_encode(hashids, buffer, numbers_count, numbers);
-    _hashids_free(numbers);
+    /* a truncated decode can never re-encode to the same string */
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK
+        || !hashids_verify_layout(hashids, ctx, str, len, &decoded))) {
+        *numbers_count = 0;
+        status = HASHIDS_ERROR_INVALID_HASH;
+    }
+    HASHIDS_STATS_RECORD(hashids, HASHIDS_STATS_DECODE_SAFE, start, len,
+        status);
 
-    return result;
+    return status;
 }
+#endif
 
-/* encode one */
-size_t
-hashids_encode_one(hashids_t *hashids, char *buffer,
-    unsigned long long number)
+/* chunk numbers kept on the stack; longer inputs use the allocator */
+#define HASHIDS_HEX_STACK_NUMBERS 32
+
+/* value of a hex digit, or -1 */
+static inline int
+hashids_hex_digit(unsigned char ch)
 {
-    return hashids_encode(hashids, buffer, 1, &number);
+    if ((unsigned char)(ch - '0') <= 9) {
+        return ch - '0';
+    }
+    ch |= 0x20;
+    if ((unsigned char)(ch - 'a') <= 5) {
+        return ch - 'a' + 10;
+    }
+    return -1;
 }
 
-/* numbers count */
-size_t
-hashids_numbers_count(hashids_t *hashids, const char *str)
+/* cut hex digits (from a string, or nibbles of bytes when hex is NULL)
+   into HASHIDS_HEX_CHUNK-digit numbers, each behind a leading 1 */
+static int
+hashids_hex_to_numbers(const char *hex, const unsigned char *bytes,
+    size_t digits_count, unsigned long long *numbers)
 {
-    size_t numbers_count;
-    char ch;
-    const char *p;
-
-    /* skip characters until we find a guard */
-    if (hashids->min_hash_length) {
-        p = str;
-        while ((ch = *p)) {
-            if (strchr(hashids->guards, ch)) {
-                str = p + 1;
-                break;
+    size_t i, end;
+    unsigned long long number;
+    int digit;
+
+    for (i = 0; i < digits_count; ++numbers) {
+        end = digits_count - i > HASHIDS_HEX_CHUNK ? i + HASHIDS_HEX_CHUNK
+            : digits_count;
+        for (number = 1; i < end; ++i) {
+            if (hex) {
+                digit = hashids_hex_digit((unsigned char)hex[i]);
+                if (HASHIDS_UNLIKELY(digit < 0)) {
+                    return HASHIDS_ERROR_INVALID_NUMBER;
+                }
+            } else {
+                digit = bytes[i >> 1] >> ((~i & 1) << 2) & 15;
             }
-
-            p++;
-        }
-    }
-
-    /* parse */
-    numbers_count = 0;
-    while ((ch = *str)) {
-        if (strchr(hashids->guards, ch)) {
-            break;
-        }
-        if (strchr(hashids->separators, ch)) {
-            numbers_count++;
-            str++;
-            continue;
+            number = number << 4 | (unsigned)digit;
         }
-        if (!strchr(hashids->alphabet, ch)) {
-            hashids_errno = HASHIDS_ERROR_INVALID_HASH;
-            return 0;
-        }
-
-        str++;
+        *numbers = number;
     }
 
-    /* account for the last number */
-    return numbers_count + 1;
+    return HASHIDS_ERROR_OK;
 }
 
-/* decode */
-size_t
-hashids_decode(hashids_t *hashids, const char *str,
-    unsigned long long *numbers, size_t numbers_max)
+/* encode hex digits or bytes as a multi-number hash */
+static int
+hashids_encode_chunks(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, const char *hex, const unsigned char *bytes,
+    size_t digits_count, size_t *length)
 {
+    unsigned long long stack[HASHIDS_HEX_STACK_NUMBERS], *numbers;
     size_t numbers_count;
-    unsigned long long number;
-    char lottery, ch, *p, *c;
-    int p_max;
+    int status;
 
-    if (!numbers || !numbers_max) {
-        return hashids_numbers_count(hashids, str);
+    *length = 0;
+    if (HASHIDS_UNLIKELY(!digits_count)) {
+        buffer[0] = '\0';
+        return HASHIDS_ERROR_INVALID_NUMBER;
     }
 
-    /* skip characters until we find a guard */
-    if (hashids->min_hash_length) {
-        p = (char *)str;
-        while ((ch = *p)) {
-            if (strchr(hashids->guards, ch)) {
-                str = p + 1;
-                break;
-            }
-
-            p++;
+    numbers_count = hashids_div_ceil_size_t(digits_count, HASHIDS_HEX_CHUNK);
+    numbers = stack;
+    if (HASHIDS_UNLIKELY(numbers_count > HASHIDS_HEX_STACK_NUMBERS)) {
+        numbers = (unsigned long long *)hashids_instance_alloc(hashids,
+            numbers_count * sizeof(unsigned long long));
+        if (HASHIDS_UNLIKELY(!numbers)) {
+            return HASHIDS_ERROR_ALLOC;
         }
     }
 
-    /* get the lottery character */
-    lottery = *str++;
-
-    /* copy the alphabet into internal buffer 1 */
-    strncpy(hashids->alphabet_copy_1, hashids->alphabet,
-        hashids->alphabet_length);
-
-    /* alphabet-like buffer used for salt at each iteration */
-    hashids->alphabet_copy_2[0] = lottery;
-    hashids->alphabet_copy_2[1] = '\0';
-    strncat(hashids->alphabet_copy_2, hashids->salt,
-        hashids->alphabet_length - 1);
-    p = hashids->alphabet_copy_2 + hashids->salt_length + 1;
-    p_max = (int)(hashids->alphabet_length - 1 - hashids->salt_length);
-    if (p_max > 0) {
-        strncat(hashids->alphabet_copy_2, hashids->alphabet,
-            p_max);
+    status = hashids_hex_to_numbers(hex, bytes, digits_count, numbers);
+    if (HASHIDS_LIKELY(status == HASHIDS_ERROR_OK)) {
+        *length = hashids_encode_r(hashids, ctx, buffer, numbers_count,
+            numbers);
     } else {
-        hashids->alphabet_copy_2[hashids->alphabet_length] = '\0';
+        buffer[0] = '\0';
     }
 
-    /* first shuffle */
-    hashids_shuffle(hashids->alphabet_copy_1, hashids->alphabet_length,
-        hashids->alphabet_copy_2, hashids->alphabet_length);
+    if (numbers != stack) {
+        hashids_instance_free(hashids, numbers);
+    }
+    return status;
+}
 
-    /* parse */
-    numbers_count = 0;
-    number = 0;
-    while ((ch = *str)) {
-        if (strchr(hashids->guards, ch)) {
-            break;
+/* turn chunk numbers back into hex digits (uppercase, NUL terminated) or
+   bytes; only what hashids_hex_to_numbers produces is accepted */
+static int
+hashids_numbers_to_hex(const unsigned long long *numbers,
+    size_t numbers_count, char *hex, unsigned char *bytes, size_t output_size,
+    size_t *length)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    size_t i, k, digits_count, needed;
+    unsigned digit;
+
+    /* every number is 1 followed by a whole chunk (all but the last) or
+       a partial one (the last) */
+    for (i = 0, digits_count = 0; i < numbers_count; ++i) {
+        k = hashids_log2_64(numbers[i]);
+        if (HASHIDS_UNLIKELY(!k || k % 4
+            || (i + 1 < numbers_count ? k / 4 != HASHIDS_HEX_CHUNK
+                : k / 4 > HASHIDS_HEX_CHUNK))) {
+            return HASHIDS_ERROR_INVALID_HASH;
         }
-        if (strchr(hashids->separators, ch)) {
-            /* store the number */
-            *numbers++ = number;
-
-            /* check limit */
-            if (++numbers_count >= numbers_max) {
-                return numbers_count;
-            }
+        digits_count += k / 4;
+    }
+    if (HASHIDS_UNLIKELY(bytes && digits_count % 2)) {
+        return HASHIDS_ERROR_INVALID_HASH;
+    }
 
-            number = 0;
+    needed = hex ? digits_count + 1 : digits_count / 2;
+    if (HASHIDS_UNLIKELY(output_size < needed)) {
+        *length = needed;
+        return HASHIDS_ERROR_BUFFER_SIZE;
+    }
 
-            /* resalt the alphabet */
-            if (p_max > 0) {
-                strncpy(p, hashids->alphabet_copy_1, p_max);
+    for (i = 0, digits_count = 0; i < numbers_count; ++i) {
+        for (k = hashids_log2_64(numbers[i]) / 4; k--; ++digits_count) {
+            digit = (unsigned)(numbers[i] >> (k * 4)) & 15;
+            if (hex) {
+                hex[digits_count] = hex_digits[digit];
+            } else if (digits_count & 1) {
+                bytes[digits_count >> 1] |= (unsigned char)digit;
+            } else {
+                bytes[digits_count >> 1] = (unsigned char)(digit << 4);
             }
-            hashids_shuffle(hashids->alphabet_copy_1, hashids->alphabet_length,
-                hashids->alphabet_copy_2, hashids->alphabet_length);
-
-            str++;
-            continue;
-        }
-        if (!(c = strchr(hashids->alphabet_copy_1, ch))) {
-            hashids_errno = HASHIDS_ERROR_INVALID_HASH;
-            return 0;
         }
-
-        number *= hashids->alphabet_length;
-        number += c - hashids->alphabet_copy_1;
-
-        str++;
+    }
+    if (hex) {
+        hex[digits_count] = '\0';
     }
 
-    /* store last number */
-    *numbers = number;
-
-    return numbers_count + 1;
-}
-
-/* unsafe decode */
-size_t
-hashids_decode_unsafe(hashids_t *hashids, const char *str,
-    unsigned long long *numbers)
-{
-    return hashids_decode(hashids, str, numbers, (size_t)-1);
+    *length = hex ? digits_count : digits_count / 2;
+    return HASHIDS_ERROR_OK;
 }
 
-/* safe decode */
-size_t
-hashids_decode_safe(hashids_t *hashids, const char *str,
-    unsigned long long *numbers, size_t numbers_max)
+/* safe-decode a hash of chunk numbers into hex digits or bytes */
+static int
+hashids_decode_chunks(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, char *hex, unsigned char *bytes, size_t output_size,
+    size_t *length)
 {
+    unsigned long long stack[HASHIDS_HEX_STACK_NUMBERS], *numbers;
     size_t numbers_count;
-    size_t len;
-    char *p;
+    int status;
 
-    numbers_count = hashids_decode(hashids, str, numbers, numbers_max);
-    if (HASHIDS_UNLIKELY(!numbers_count)) {
-        hashids_errno = HASHIDS_ERROR_INVALID_HASH;
-        return 0;
+    *length = 0;
+    status = hashids_numbers_count_s(hashids, str, &numbers_count);
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK)) {
+        return status;
     }
 
-    len = hashids_estimate_encoded_size(hashids, numbers_count, numbers);
-
-    p = (char *)_hashids_alloc(len);
-    if (HASHIDS_UNLIKELY(!p)) {
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return 0;
+    numbers = stack;
+    if (HASHIDS_UNLIKELY(numbers_count > HASHIDS_HEX_STACK_NUMBERS)) {
+        numbers = (unsigned long long *)hashids_instance_alloc(hashids,
+            numbers_count * sizeof(unsigned long long));
+        if (HASHIDS_UNLIKELY(!numbers)) {
+            return HASHIDS_ERROR_ALLOC;
+        }
     }
 
-    len = hashids_encode(hashids, p, numbers_count, numbers);
-    if (HASHIDS_UNLIKELY(!len)) {
-        _hashids_free(p);
-        return 0;
+    status = hashids_decode_safe_s(hashids, ctx, str, numbers, numbers_count,
+        &numbers_count);
+    if (HASHIDS_LIKELY(status == HASHIDS_ERROR_OK)) {
+        status = hashids_numbers_to_hex(numbers, numbers_count, hex, bytes,
+            output_size, length);
     }
 
-    if (strcmp(str, p) != 0) {
-        _hashids_free(p);
-        hashids_errno = HASHIDS_ERROR_INVALID_HASH;
-        return 0;
+    if (numbers != stack) {
+        hashids_instance_free(hashids, numbers);
     }
-
-    _hashids_free(p);
-    return numbers_count;
+    return status;
 }
 
-/* encode hex */
+/* buffer size for encoding hex_length hex digits (or hex_length / 2
+   bytes) */
 size_t
-hashids_encode_hex(hashids_t *hashids, char *buffer,
-    const char *hex_str)
+hashids_estimate_encoded_hex_size(const hashids_t *hashids,
+    size_t hex_length)
 {
-    int len;
-    char *temp, *p;
-    size_t result;
-    unsigned long long number;
+    size_t numbers_count, result_len;
 
-    len = (int)strlen(hex_str);
-    temp = (char *)_hashids_alloc(len + 2);
+    /* every chunk number is below 2^(4 * HASHIDS_HEX_CHUNK + 1) */
+    numbers_count = hashids_div_ceil_size_t(hex_length, HASHIDS_HEX_CHUNK);
+    result_len = 1 + numbers_count * (hashids_div_ceil_unsigned_short(
+        4 * HASHIDS_HEX_CHUNK + 1, hashids_log2_64(hashids->alphabet_length))
+        + 1);
 
-    if (!temp) {
-        hashids_errno = HASHIDS_ERROR_ALLOC;
-        return 0;
+    if (result_len < hashids->min_hash_length) {
+        result_len = hashids->min_hash_length;
     }
 
-    temp[0] = '1';
-    strncpy(temp + 1, hex_str, len);
+    return result_len + 1 /* terminating NUL */;
+}
 
-    number = strtoull(temp, &p, 16);
+/* encode hex digits (reentrant, status-returning) */
+int
+hashids_encode_hex_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, const char *hex_str, size_t hex_length, size_t *length)
+{
+    return hashids_encode_chunks(hashids, ctx, buffer, hex_str, NULL,
+        hex_length, length);
+}
 
-    if (p == temp) {
-        _hashids_free(temp);
-        hashids_errno = HASHIDS_ERROR_INVALID_NUMBER;
-        return 0;
-    }
+/* encode bytes (reentrant, status-returning) */
+int
+hashids_encode_bytes_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, const unsigned char *bytes, size_t bytes_count,
+    size_t *length)
+{
+    return hashids_encode_chunks(hashids, ctx, buffer, NULL, bytes,
+        2 * bytes_count, length);
+}
 
-    result = hashids_encode(hashids, buffer, 1, &number);
-    _hashids_free(temp);
+/* decode to hex digits (reentrant, status-returning) */
+int
+hashids_decode_hex_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, char *output, size_t output_size, size_t *length)
+{
+    return hashids_decode_chunks(hashids, ctx, str, output, NULL,
+        output_size, length);
+}
 
-    return result;
+/* decode to bytes (reentrant, status-returning) */
+int
+hashids_decode_bytes_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned char *output, size_t output_size,
+    size_t *bytes_count)
+{
+    return hashids_decode_chunks(hashids, ctx, str, NULL, output,
+        output_size, bytes_count);
 }
 
-/* decode hex */
+/* encode hex */
 size_t
-hashids_decode_hex(hashids_t *hashids, char *str, char *output)
+hashids_encode_hex(hashids_t *hashids, char *buffer,
+    const char *hex_str)
 {
-    size_t result, i;
-    unsigned long long number;
-    char ch, *temp;
-
-    result = hashids_numbers_count(hashids, str);
+    hashids_ctx_t ctx;
+    size_t result;
+    int status;
 
-    if (result != 1) {
-        return 0;
+    status = hashids_encode_hex_s(hashids, &ctx, buffer, hex_str,
+        strlen(hex_str), &result);
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK)) {
+        hashids_errno = status;
     }
 
-    result = hashids_decode_unsafe(hashids, str, &number);
+    return result;
+}
 
-    if (result != 1) {
+/* decode hex (output must hold HASHIDS_DECODE_HEX_SIZE bytes; there is no
+   size argument, so longer results are refused) */
+size_t
+hashids_decode_hex(hashids_t *hashids, char *str, char *output)
+{
+    hashids_ctx_t ctx;
+    size_t length;
+    int status;
+
+    status = hashids_decode_hex_s(hashids, &ctx, str, output,
+        HASHIDS_DECODE_HEX_SIZE, &length);
+    if (HASHIDS_UNLIKELY(status != HASHIDS_ERROR_OK)) {
+        hashids_errno = status;
         return 0;
     }
 
-    temp = output;
-
-    do {
-        ch = number % 16;
-        if (ch > 9) {
-            ch += 'A' - 10;
-        } else {
-            ch += '0';
-        }
-
-        *temp++ = (char)ch;
-
-        number /= 16;
-    } while (number);
-
-    temp--;
-    *temp = 0;
-
-    for (i = 0; i < (size_t)((temp - output) / 2); ++i) {
-        ch = *(output + i);
-        *(output + i) = *(temp - 1 - i);
-        *(temp - 1 - i) = ch;
-    }
-
     return 1;
 }
@@ -3,6 +3,10 @@
 
 #include <stdlib.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* version constants */
 #define HASHIDS_VERSION "1.2.1"
 #define HASHIDS_VERSION_MAJOR 1
@@ -12,6 +16,9 @@
 /* minimal alphabet length */
 #define HASHIDS_MIN_ALPHABET_LENGTH 16u
 
+/* maximal alphabet length (unique non-NUL bytes) */
+#define HASHIDS_MAX_ALPHABET_LENGTH 255u
+
 /* separator divisor */
 #define HASHIDS_SEPARATOR_DIVISOR 3.5f
 
@@ -32,6 +39,38 @@
 /* default separators */
 #define HASHIDS_DEFAULT_SEPARATORS "cfhistuCFHISTU"
 
+/* character classes */
+#define HASHIDS_CLASS_INVALID           0x00
+#define HASHIDS_CLASS_ALPHABET          0x01
+#define HASHIDS_CLASS_SEPARATOR         0x02
+#define HASHIDS_CLASS_GUARD             0x04
+
+/* decode classification kernels */
+#define HASHIDS_SCAN_SCALAR             0
+#define HASHIDS_SCAN_SSSE3              1
+#define HASHIDS_SCAN_AVX2               2
+#define HASHIDS_SCAN_NEON               3
+
+/* fixed-salt shuffle kernels */
+#define HASHIDS_PERMUTE_SCALAR          0
+#define HASHIDS_PERMUTE_SSSE3           1
+#define HASHIDS_PERMUTE_VBMI            2
+#define HASHIDS_PERMUTE_NEON            3
+
+/* instance snapshot format */
+#define HASHIDS_SNAPSHOT_VERSION        1
+
+/* hex digits per number in hex & byte hashes (the reference
+   implementations' chunking) */
+#define HASHIDS_HEX_CHUNK               12u
+
+/* output bound of the legacy hashids_decode_hex (16 digits & a NUL, as
+   when it took single-number hashes only) */
+#define HASHIDS_DECODE_HEX_SIZE         17u
+
+/* alphabet position of bytes outside the alphabet */
+#define HASHIDS_INDEX_NONE              0xFF
+
 /* error codes */
 #define HASHIDS_ERROR_OK                0
 #define HASHIDS_ERROR_ALLOC             -1
@@ -39,8 +78,11 @@
 #define HASHIDS_ERROR_ALPHABET_SPACE    -3
 #define HASHIDS_ERROR_INVALID_HASH      -4
 #define HASHIDS_ERROR_INVALID_NUMBER    -5
+#define HASHIDS_ERROR_INVALID_SNAPSHOT  -6
+#define HASHIDS_ERROR_BUFFER_SIZE       -7
 
-/* thread-safe hashids_errno indirection */
+/* thread-local hashids_errno indirection (the *_s functions report a
+   status instead and never touch it) */
 extern int *__hashids_errno_addr(void);
 #define hashids_errno (*__hashids_errno_addr())
 
@@ -48,25 +90,172 @@ extern int *__hashids_errno_addr(void);
 extern void *(*_hashids_alloc)(size_t size);
 extern void (*_hashids_free)(void *ptr);
 
-/* the hashids "object" */
+/* allocator carrying a user context (alloc must return zeroed memory) */
+struct hashids_allocator_s {
+    void *(*alloc)(void *user_data, size_t size);
+    void (*free)(void *user_data, void *ptr);
+    void *user_data;
+};
+typedef struct hashids_allocator_s hashids_allocator_t;
+
+/* the default allocator forwards to _hashids_alloc & _hashids_free */
+extern const hashids_allocator_t hashids_default_allocator;
+
+/* bump arena over caller-provided memory (free only rolls back the most
+   recent block; hashids_arena_reset() releases everything at once) */
+struct hashids_arena_s {
+    char *buffer;
+    size_t size;
+    size_t used;
+    size_t last;
+};
+typedef struct hashids_arena_s hashids_arena_t;
+
+/* arena alignment */
+#define HASHIDS_ARENA_ALIGNMENT 16u
+
+/* 128-bit numbers, where the compiler has them */
+#if defined(__SIZEOF_INT128__)
+#   define HASHIDS_HAVE_INT128 1
+__extension__ typedef unsigned __int128 hashids_uint128_t;
+#endif
+
+/* precomputed division by a constant */
+struct hashids_divisor_s {
+    unsigned long long divisor;
+    unsigned long long magic;
+    unsigned int shift;
+};
+
+/* inline storage bounds: at most 255 unique bytes make at most
+   ceil(255 / 3.5) separators and ceil(255 / 12) guards */
+#define HASHIDS_MAX_SEPARATORS_COUNT 73u
+#define HASHIDS_MAX_GUARDS_COUNT 22u
+
+/* instance alignment */
+#define HASHIDS_CACHE_LINE 64u
+#if defined(__GNUC__) || defined(__clang__)
+#   define HASHIDS_ALIGNED(n) __attribute__((aligned(n)))
+#else
+#   define HASHIDS_ALIGNED(n)
+#endif
+
+/* the hashids "object": a single cache-line-aligned block with the hot
+   fields first (lengths & reciprocals, then the character sets, then the
+   lookup tables) and no pointers into itself (read-only once initialized,
+   copyable by value) */
 struct hashids_s {
-    char *alphabet;
-    char *alphabet_copy_1;
-    char *alphabet_copy_2;
     size_t alphabet_length;
-
-    char *salt;
+    size_t separators_count;
+    size_t guards_count;
+    size_t min_hash_length;
     size_t salt_length;
 
-    char *separators;
-    size_t separators_count;
+    struct hashids_divisor_s alphabet_divisor;
+    struct hashids_divisor_s alphabet_squared_divisor;
+
+    char alphabet[HASHIDS_MAX_ALPHABET_LENGTH + 1];
+    char separators[HASHIDS_MAX_SEPARATORS_COUNT + 1];
+    char guards[HASHIDS_MAX_GUARDS_COUNT + 1];
+
+    /* past alphabet_length - 1 bytes the salt only matters during init, so
+       at most HASHIDS_MAX_ALPHABET_LENGTH bytes of it are kept */
+    char salt[HASHIDS_MAX_ALPHABET_LENGTH + 1];
+
+    unsigned char classes[256];
+    unsigned char indexes[256];
+
+    /* alphabet_length^(k + 1) for every power that fits 64 bits (at most
+       63, with a 2-byte alphabet): digit counts without dividing */
+    size_t alphabet_powers_count;
+    unsigned long long alphabet_powers[64];
+
+    /* per-class nibble bitsets for the vector kernels (ASCII sets only) */
+    unsigned char nibbles[3][16];
+    int scan_kernel;
+
+    /* optional shuffle cache (separate allocation, shared by copies) */
+    char *shuffles;
+    unsigned char *shuffles_digits;
+    size_t shuffles_depth;
+
+    /* per-lottery shuffles compiled to 64-byte permutation rows, when the
+       per-number salt is fixed (salt_length >= alphabet_length - 1, up to
+       64 alphabet bytes; separate allocation, shared by copies) */
+    unsigned char *permutations;
+    int permute_kernel;
+
+    /* optional padding cache: the alphabet of every padding round per
+       lottery & number count (separate allocation, shared by copies) */
+    char *padding;
+    size_t padding_depth;
+    size_t padding_rounds;
+
+#ifdef HASHIDS_ENABLE_STATS
+    /* per-thread counter slots (after the instance in its block, shared
+       by copies) */
+    struct hashids_stats_slot_s *stats;
+#endif
 
-    char *guards;
-    size_t guards_count;
+    hashids_allocator_t allocator;
+    size_t block_offset;
+} HASHIDS_ALIGNED(HASHIDS_CACHE_LINE);
+typedef struct hashids_s hashids_t;
 
-    size_t min_hash_length;
+/* per-call scratch space, owned by the caller (one per thread) */
+struct hashids_ctx_s {
+    char alphabet_copy_1[HASHIDS_MAX_ALPHABET_LENGTH + 1];
+    char alphabet_copy_2[HASHIDS_MAX_ALPHABET_LENGTH + 1];
+    unsigned char digits[HASHIDS_MAX_ALPHABET_LENGTH];
 };
-typedef struct hashids_s hashids_t;
+typedef struct hashids_ctx_s hashids_ctx_t;
+
+/* decode result cache: bounds on what one entry keeps (longer hashes and
+   hashes of more numbers bypass it) */
+#define HASHIDS_DECODE_CACHE_KEY_MAX 94u
+#define HASHIDS_DECODE_CACHE_NUMBERS 4u
+
+typedef struct hashids_decode_cache_s hashids_decode_cache_t;
+
+struct hashids_decode_cache_stats_s {
+    unsigned long long hits;            /* negative hits included */
+    unsigned long long negative_hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+};
+typedef struct hashids_decode_cache_stats_s hashids_decode_cache_stats_t;
+
+#ifdef HASHIDS_ENABLE_STATS
+/* instrumentation (library and callers must agree on HASHIDS_ENABLE_STATS;
+   without it none of this exists and the hooks compile to nothing) */
+
+/* timed operations */
+#define HASHIDS_STATS_ENCODE            0
+#define HASHIDS_STATS_DECODE            1
+#define HASHIDS_STATS_DECODE_SAFE       2
+#define HASHIDS_STATS_OPS               3
+
+/* histogram bucket b counts calls of [4^b, 4^(b+1)) ticks (the last one
+   everything above); ticks are TSC cycles on x86, the virtual counter on
+   ARM64 and clock() elsewhere */
+#define HASHIDS_STATS_BUCKETS           16
+
+/* rejections are counted by -error code */
+#define HASHIDS_STATS_ERRORS            8
+
+/* counter slots per instance: threads beyond this many share one */
+#define HASHIDS_STATS_SLOTS             16
+
+struct hashids_stats_s {
+    unsigned long long calls[HASHIDS_STATS_OPS];
+    unsigned long long bytes[HASHIDS_STATS_OPS];  /* produced/consumed */
+    unsigned long long shuffles;
+    unsigned long long padding_iterations;
+    unsigned long long errors[HASHIDS_STATS_ERRORS];
+    unsigned long long ticks[HASHIDS_STATS_OPS][HASHIDS_STATS_BUCKETS];
+};
+typedef struct hashids_stats_s hashids_stats_t;
+#endif
 
 /* exported function definitions */
 void
@@ -75,6 +264,10 @@ hashids_shuffle(char *str, size_t str_length, char *salt, size_t salt_length);
 void
 hashids_free(hashids_t *hashids);
 
+hashids_t *
+hashids_init4(const char *salt, size_t min_hash_length,
+    const char *alphabet, const hashids_allocator_t *allocator);
+
 hashids_t *
 hashids_init3(const char *salt, size_t min_hash_length,
     const char *alphabet);
@@ -85,9 +278,35 @@ hashids_init2(const char *salt, size_t min_hash_length);
 hashids_t *
 hashids_init(const char *salt);
 
+void
+hashids_arena_init(hashids_arena_t *arena, void *buffer, size_t size);
+
+void
+hashids_arena_reset(hashids_arena_t *arena);
+
+hashids_allocator_t
+hashids_arena_allocator(hashids_arena_t *arena);
+
+int
+hashids_cache_shuffles(hashids_t *hashids, size_t depth);
+
+int
+hashids_cache_padding(hashids_t *hashids, size_t depth);
+
 size_t
-hashids_estimate_encoded_size(hashids_t *hashids, size_t numbers_count,
-    unsigned long long *numbers);
+hashids_footprint(const hashids_t *hashids);
+
+size_t
+hashids_snapshot_save(const hashids_t *hashids, void *buffer,
+    size_t buffer_size);
+
+hashids_t *
+hashids_snapshot_load(const void *buffer, size_t size,
+    const hashids_allocator_t *allocator);
+
+size_t
+hashids_estimate_encoded_size(const hashids_t *hashids, size_t numbers_count,
+    const unsigned long long *numbers);
 
 size_t
 hashids_estimate_encoded_size_v(hashids_t *hashids, size_t numbers_count, ...);
@@ -104,12 +323,55 @@ hashids_encode_one(hashids_t *hashids, char *buffer,
     unsigned long long number);
 
 size_t
-hashids_numbers_count(hashids_t *hashids, const char *str);
+hashids_encode_r(const hashids_t *hashids, hashids_ctx_t *ctx, char *buffer,
+    size_t numbers_count, const unsigned long long *numbers);
+
+size_t
+hashids_encode_one_r(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, unsigned long long number);
+
+int
+hashids_encode_s(const hashids_t *hashids, hashids_ctx_t *ctx, char *buffer,
+    size_t numbers_count, const unsigned long long *numbers, size_t *length);
+
+size_t
+hashids_encode_batch(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, size_t buffer_size, size_t groups_count,
+    const size_t *numbers_counts, const unsigned long long *numbers,
+    size_t *offsets, size_t *lengths);
+
+size_t
+hashids_numbers_count(const hashids_t *hashids, const char *str);
+
+int
+hashids_numbers_count_s(const hashids_t *hashids, const char *str,
+    size_t *numbers_count);
 
 size_t
 hashids_decode(hashids_t *hashids, const char *str,
     unsigned long long *numbers, size_t numbers_max);
 
+size_t
+hashids_decode_r(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max);
+
+int
+hashids_decode_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_count);
+
+size_t
+hashids_decode_batch(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *buffer, size_t hashes_count, const size_t *offsets,
+    const size_t *lengths, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_counts, int *statuses);
+
+size_t
+hashids_decode_batch_delimited(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *buffer, size_t buffer_size, char delimiter, size_t hashes_max,
+    unsigned long long *numbers, size_t numbers_max, size_t *numbers_counts,
+    int *statuses, size_t *consumed);
+
 size_t
 hashids_decode_unsafe(hashids_t *hashids, const char *str,
     unsigned long long *numbers);
@@ -119,9 +381,102 @@ hashids_decode_safe(hashids_t *hashids, const char *str,
     unsigned long long *numbers, size_t numbers_max);
 
 size_t
+hashids_decode_safe_r(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max);
+
+int
+hashids_decode_safe_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_count);
+
+#ifdef HASHIDS_ENABLE_STATS
+void
+hashids_stats_snapshot(const hashids_t *hashids, hashids_stats_t *stats);
+
+void
+hashids_stats_merge(hashids_stats_t *stats, const hashids_stats_t *other);
+
+void
+hashids_stats_reset(const hashids_t *hashids);
+#endif
+
+hashids_decode_cache_t *
+hashids_decode_cache_create(const hashids_t *hashids, size_t capacity);
+
+void
+hashids_decode_cache_free(hashids_decode_cache_t *cache);
+
+int
+hashids_decode_cached_s(hashids_decode_cache_t *cache, hashids_ctx_t *ctx,
+    const char *str, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_count);
+
+void
+hashids_decode_cache_stats(hashids_decode_cache_t *cache,
+    hashids_decode_cache_stats_t *stats);
+
+size_t
+hashids_decode_safe_batch(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *buffer, size_t hashes_count, const size_t *offsets,
+    const size_t *lengths, unsigned long long *numbers, size_t numbers_max,
+    size_t *numbers_counts, int *statuses);
+
+#ifdef HASHIDS_HAVE_INT128
+size_t
+hashids_estimate_encoded_size128(const hashids_t *hashids,
+    size_t numbers_count, const hashids_uint128_t *numbers);
+
+int
+hashids_encode128_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, size_t numbers_count, const hashids_uint128_t *numbers,
+    size_t *length);
+
+int
+hashids_decode128_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, hashids_uint128_t *numbers, size_t numbers_max,
+    size_t *numbers_count);
+
+int
+hashids_decode_safe128_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, hashids_uint128_t *numbers, size_t numbers_max,
+    size_t *numbers_count);
+#endif
+
+size_t
+hashids_estimate_encoded_hex_size(const hashids_t *hashids,
+    size_t hex_length);
+
+int
+hashids_encode_hex_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, const char *hex_str, size_t hex_length, size_t *length);
+
+int
+hashids_encode_bytes_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    char *buffer, const unsigned char *bytes, size_t bytes_count,
+    size_t *length);
+
+int
+hashids_decode_hex_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, char *output, size_t output_size, size_t *length);
+
+int
+hashids_decode_bytes_s(const hashids_t *hashids, hashids_ctx_t *ctx,
+    const char *str, unsigned char *output, size_t output_size,
+    size_t *bytes_count);
+
+/* legacy hex calls: size the hashids_encode_hex buffer with
+   hashids_estimate_encoded_hex_size (long inputs take many chunks);
+   hashids_decode_hex writes at most HASHIDS_DECODE_HEX_SIZE bytes and
+   fails with HASHIDS_ERROR_BUFFER_SIZE beyond, so use
+   hashids_decode_hex_s for long hashes */
+size_t
 hashids_encode_hex(hashids_t *hashids, char *buffer, const char *hex_str);
 
 size_t
 hashids_decode_hex(hashids_t *hashids, char *str, char *output);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,299 @@
+#ifndef HASHIDS_HPP
+#define HASHIDS_HPP 1
+
+/*
+ * Header-only C++17 wrapper over hashids.h for salts known only at run time
+ * (see hashids_static.hpp for fixed ones).  A codec owns its instance and is
+ * move-only; encoding and decoding write into caller buffers, keep their
+ * scratch context on the stack and never allocate.  Errors are reported
+ * std::to_chars-style, as a result carrying an errc (errc{} on success).
+ * The span overloads need C++20.
+ *
+ *     hashids::errc ec;
+ *     auto codec = hashids::codec::create("salt", 6,
+ *         "ABCDEFGHJKLMNPQRSTUVXYZ23456789", ec);
+ *     auto [id, ec2] = codec.encode_one(42);
+ *     unsigned long long numbers[4];
+ *     auto [count, ec3] = codec.decode(id.view(), numbers, 4);
+ */
+
+#include <cstddef>
+#include <string_view>
+
+#if defined(__has_include)
+#   if __has_include(<span>) && __cplusplus > 201703L
+#       include <span>
+#   endif
+#endif
+
+#include "hashids.h"
+
+namespace hashids {
+
+/* HASHIDS_ERROR_* as a scoped enum, plus the buffer checks of this header */
+enum class errc : int {
+    alloc = HASHIDS_ERROR_ALLOC,
+    alphabet_length = HASHIDS_ERROR_ALPHABET_LENGTH,
+    alphabet_space = HASHIDS_ERROR_ALPHABET_SPACE,
+    invalid_hash = HASHIDS_ERROR_INVALID_HASH,
+    invalid_number = HASHIDS_ERROR_INVALID_NUMBER,
+    invalid_snapshot = HASHIDS_ERROR_INVALID_SNAPSHOT,
+    buffer_size = HASHIDS_ERROR_BUFFER_SIZE
+};
+
+static_assert(HASHIDS_ERROR_OK == 0, "errc{} must mean success");
+
+/* NUL-terminated string of at most Capacity characters, kept inline */
+template <std::size_t Capacity>
+class inline_string {
+    static_assert(Capacity <= 0xFF, "length is kept in one byte");
+
+    char data_[Capacity + 1] = {};
+    unsigned char size_ = 0;
+
+    friend class codec;
+
+public:
+    static constexpr std::size_t capacity = Capacity;
+
+    constexpr const char *
+    c_str() const noexcept
+    {
+        return data_;
+    }
+
+    constexpr const char *
+    data() const noexcept
+    {
+        return data_;
+    }
+
+    constexpr std::size_t
+    size() const noexcept
+    {
+        return size_;
+    }
+
+    constexpr bool
+    empty() const noexcept
+    {
+        return !size_;
+    }
+
+    constexpr std::string_view
+    view() const noexcept
+    {
+        return std::string_view(data_, size_);
+    }
+
+    constexpr operator std::string_view() const noexcept
+    {
+        return view();
+    }
+};
+
+/* one 64-bit number, padded to a minimal hash length of up to 62 (64 bytes
+   with the length) */
+using id_string = inline_string<62>;
+
+struct encode_result {
+    std::string_view hash;
+    errc ec;
+};
+
+template <std::size_t Capacity>
+struct encode_one_result {
+    inline_string<Capacity> id;
+    errc ec;
+};
+
+struct decode_result {
+    std::size_t count;
+    errc ec;
+};
+
+/* owning handle to a hashids_t; empty after a failed create or a move */
+class codec {
+    hashids_t *hashids_ = nullptr;
+
+public:
+    codec() noexcept = default;
+
+    /* adopt an instance (hashids_init4(), hashids_snapshot_load(), ...) */
+    explicit codec(hashids_t *hashids) noexcept : hashids_(hashids)
+    {
+    }
+
+    codec(const codec &) = delete;
+    codec &operator=(const codec &) = delete;
+
+    codec(codec &&other) noexcept : hashids_(other.hashids_)
+    {
+        other.hashids_ = nullptr;
+    }
+
+    codec &
+    operator=(codec &&other) noexcept
+    {
+        if (this != &other) {
+            hashids_free(hashids_);
+            hashids_ = other.hashids_;
+            other.hashids_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    ~codec()
+    {
+        hashids_free(hashids_);
+    }
+
+    /* hashids_init3(); on failure the codec is empty and ec says why */
+    static codec
+    create(const char *salt, std::size_t min_hash_length,
+        const char *alphabet, errc &ec) noexcept
+    {
+        codec c(hashids_init3(salt, min_hash_length, alphabet));
+
+        ec = c.hashids_ ? errc{} : static_cast<errc>(hashids_errno);
+
+        return c;
+    }
+
+    static codec
+    create(const char *salt, std::size_t min_hash_length, errc &ec) noexcept
+    {
+        return create(salt, min_hash_length, HASHIDS_DEFAULT_ALPHABET, ec);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return hashids_ != nullptr;
+    }
+
+    /* the instance, for the rest of hashids.h; the codec keeps owning it */
+    const hashids_t *
+    get() const noexcept
+    {
+        return hashids_;
+    }
+
+    hashids_t *
+    release() noexcept
+    {
+        hashids_t *hashids = hashids_;
+
+        hashids_ = nullptr;
+        return hashids;
+    }
+
+    /* buffer size (terminating NUL included) that encode() requires */
+    std::size_t
+    encoded_size(const unsigned long long *numbers,
+        std::size_t numbers_count) const noexcept
+    {
+        return hashids_estimate_encoded_size(hashids_, numbers_count, numbers);
+    }
+
+    /* encode many into buffer[0..buffer_size), NUL-terminated; the hash
+       views the buffer */
+    encode_result
+    encode(const unsigned long long *numbers, std::size_t numbers_count,
+        char *buffer, std::size_t buffer_size) const noexcept
+    {
+        hashids_ctx_t ctx;
+        std::size_t length;
+        int status;
+
+        if (!numbers_count) {
+            return {std::string_view(), errc::invalid_number};
+        }
+        if (encoded_size(numbers, numbers_count) > buffer_size) {
+            return {std::string_view(), errc::buffer_size};
+        }
+
+        status = hashids_encode_s(hashids_, &ctx, buffer, numbers_count,
+            numbers, &length);
+        if (status != HASHIDS_ERROR_OK) {
+            return {std::string_view(), static_cast<errc>(status)};
+        }
+
+        return {std::string_view(buffer, length), errc{}};
+    }
+
+    /* encode one into an inline string */
+    template <std::size_t Capacity = id_string::capacity>
+    encode_one_result<Capacity>
+    encode_one(unsigned long long number) const noexcept
+    {
+        encode_one_result<Capacity> result{};
+        encode_result r;
+
+        r = encode(&number, 1, result.id.data_, Capacity + 1);
+        result.id.size_ = static_cast<unsigned char>(r.hash.size());
+        result.ec = r.ec;
+
+        return result;
+    }
+
+    /* safe decode of str (no NUL needed) into numbers[0..numbers_max);
+       invalid_hash unless str is exactly what encode() produces, and
+       buffer_size only for such a hash of more than numbers_max numbers */
+    decode_result
+    decode(std::string_view str, unsigned long long *numbers,
+        std::size_t numbers_max) const noexcept
+    {
+        hashids_ctx_t ctx;
+        std::size_t offset = 0, length = str.size(), count = 0;
+        unsigned long long scratch;
+        int status = HASHIDS_ERROR_OK;
+
+        /* with no room at all, still validate (into a scratch number) */
+        if (!numbers_max) {
+            decode_result result = decode(str, &scratch, 1);
+
+            return {0, result.ec == errc::invalid_hash ? result.ec
+                : errc::buffer_size};
+        }
+
+        /* a batch of one takes a length, and stops short of a verified
+           hash whose numbers do not fit instead of rejecting it */
+        if (!hashids_decode_safe_batch(hashids_, &ctx, str.data(), 1,
+                &offset, &length, numbers, numbers_max, &count, &status)) {
+            return {0, errc::buffer_size};
+        }
+        if (status != HASHIDS_ERROR_OK) {
+            return {0, static_cast<errc>(status)};
+        }
+
+        return {count, errc{}};
+    }
+
+#ifdef __cpp_lib_span
+    std::size_t
+    encoded_size(std::span<const unsigned long long> numbers) const noexcept
+    {
+        return encoded_size(numbers.data(), numbers.size());
+    }
+
+    encode_result
+    encode(std::span<const unsigned long long> numbers,
+        std::span<char> buffer) const noexcept
+    {
+        return encode(numbers.data(), numbers.size(), buffer.data(),
+            buffer.size());
+    }
+
+    decode_result
+    decode(std::string_view str,
+        std::span<unsigned long long> numbers) const noexcept
+    {
+        return decode(str, numbers.data(), numbers.size());
+    }
+#endif
+};
+
+} /* namespace hashids */
+
+#endif
@@ -0,0 +1,639 @@
+#ifndef HASHIDS_STATIC_HPP
+#define HASHIDS_STATIC_HPP 1
+
+/*
+ * Compile-time specialized hashids for a fixed salt, minimal hash length and
+ * alphabet (C++20).  The hashids_init3() setup runs in constexpr, so an
+ * instance is nothing but constant tables, and encoding/decoding divides by
+ * a compile-time alphabet length.  Output is byte-for-byte identical to
+ * hashids.c on the same platform (`char` signedness included).
+ *
+ *     using codec = hashids::static_codec<"salt", 6, "ABCDEFGHJKLMNPQRSTUVXYZ23456789">;
+ *     char buffer[codec::max_encoded_size(1)];
+ *     codec::encode_one(buffer, 42);
+ */
+
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#include "hashids.h"
+
+namespace hashids {
+
+/* string literal usable as a template argument */
+template <std::size_t N>
+struct fixed_string {
+    char value[N];
+
+    constexpr fixed_string(const char (&str)[N]) noexcept : value{}
+    {
+        for (std::size_t i = 0; i < N; ++i) {
+            value[i] = str[i];
+        }
+    }
+
+    /* length up to the first NUL, like strlen() */
+    constexpr std::size_t
+    length() const noexcept
+    {
+        std::size_t i = 0;
+
+        while (i < N && value[i]) {
+            ++i;
+        }
+
+        return i;
+    }
+};
+
+namespace detail {
+
+/* consistent shuffle, same as hashids_shuffle() */
+constexpr void
+shuffle(char *str, std::size_t str_length, const char *salt,
+    std::size_t salt_length) noexcept
+{
+    std::ptrdiff_t i;
+    std::size_t j, v, p;
+    char temp;
+
+    if (!salt_length) {
+        return;
+    }
+
+    for (i = str_length - 1, v = 0, p = 0; i > 0; --i, ++v) {
+        if (v == salt_length) {
+            v = 0;
+        }
+        p += salt[v];
+        j = (salt[v] + v + p) % i;
+        temp = str[i];
+        str[i] = str[j];
+        str[j] = temp;
+    }
+}
+
+/* position of ch in str[0..length), or length */
+constexpr std::size_t
+find(const char *str, std::size_t length, char ch) noexcept
+{
+    std::size_t i = 0;
+
+    while (i < length && str[i] != ch) {
+        ++i;
+    }
+
+    return i;
+}
+
+/* remove count characters at pos from str[0..length) */
+constexpr void
+erase(char *str, std::size_t length, std::size_t pos,
+    std::size_t count) noexcept
+{
+    for (std::size_t i = pos; i + count < length; ++i) {
+        str[i] = str[i + count];
+    }
+}
+
+/* ceil() of a positive float */
+constexpr std::size_t
+ceil(float x) noexcept
+{
+    std::size_t t = static_cast<std::size_t>(x);
+
+    return static_cast<float>(t) < x ? t + 1 : t;
+}
+
+/* the instance hashids_init3() would build */
+struct config {
+    std::array<char, 256> alphabet{};
+    std::size_t alphabet_length = 0;
+
+    std::array<char, 256> separators{};
+    std::size_t separators_count = 0;
+
+    std::array<char, 256> guards{};
+    std::size_t guards_count = 0;
+
+    int error = HASHIDS_ERROR_OK;
+};
+
+template <std::size_t SN, std::size_t AN>
+constexpr config
+make_config(const fixed_string<SN> &salt, const fixed_string<AN> &alphabet)
+{
+    constexpr std::string_view default_separators =
+        HASHIDS_DEFAULT_SEPARATORS;
+    config c{};
+    std::size_t i, count, salt_length;
+    char ch;
+
+    salt_length = salt.length();
+
+    /* extract only the unique characters */
+    for (i = 0; i < alphabet.length(); ++i) {
+        ch = alphabet.value[i];
+        if (find(c.alphabet.data(), c.alphabet_length, ch)
+            == c.alphabet_length) {
+            c.alphabet[c.alphabet_length++] = ch;
+        }
+    }
+
+    /* check length and whitespace */
+    if (c.alphabet_length < HASHIDS_MIN_ALPHABET_LENGTH) {
+        c.error = HASHIDS_ERROR_ALPHABET_LENGTH;
+        return c;
+    }
+    if (find(c.alphabet.data(), c.alphabet_length, 0x20) < c.alphabet_length
+        || find(c.alphabet.data(), c.alphabet_length, 0x09)
+            < c.alphabet_length) {
+        c.error = HASHIDS_ERROR_ALPHABET_SPACE;
+        return c;
+    }
+
+    /* take default separators out of the alphabet */
+    for (char separator : default_separators) {
+        i = find(c.alphabet.data(), c.alphabet_length, separator);
+        if (i < c.alphabet_length) {
+            c.separators[c.separators_count++] = separator;
+            erase(c.alphabet.data(), c.alphabet_length, i, 1);
+            --c.alphabet_length;
+        }
+    }
+
+    /* shuffle the separators */
+    shuffle(c.separators.data(), c.separators_count, salt.value, salt_length);
+
+    /* check if we have any/enough separators */
+    if (!c.separators_count
+        || ((static_cast<float>(c.alphabet_length)
+            / static_cast<float>(c.separators_count))
+            > HASHIDS_SEPARATOR_DIVISOR)) {
+        count = ceil(static_cast<float>(c.alphabet_length)
+            / HASHIDS_SEPARATOR_DIVISOR);
+
+        if (count == 1) {
+            count = 2;
+        }
+
+        if (count > c.separators_count) {
+            /* we need more separators - get some from alphabet */
+            std::size_t diff = count - c.separators_count;
+            for (i = 0; i < diff; ++i) {
+                c.separators[c.separators_count + i] = c.alphabet[i];
+            }
+            erase(c.alphabet.data(), c.alphabet_length, 0, diff);
+
+            c.separators_count += diff;
+            c.alphabet_length -= diff;
+        } else {
+            /* we have more than enough - truncate */
+            c.separators_count = count;
+        }
+    }
+
+    /* shuffle alphabet */
+    shuffle(c.alphabet.data(), c.alphabet_length, salt.value, salt_length);
+
+    /* take guards */
+    c.guards_count = (c.alphabet_length + HASHIDS_GUARD_DIVISOR - 1)
+        / HASHIDS_GUARD_DIVISOR;
+
+    if (c.alphabet_length < 3) {
+        /* take some from separators */
+        for (i = 0; i < c.guards_count; ++i) {
+            c.guards[i] = c.separators[i];
+        }
+        erase(c.separators.data(), c.separators_count, 0, c.guards_count);
+
+        c.separators_count -= c.guards_count;
+    } else {
+        /* take them from alphabet */
+        for (i = 0; i < c.guards_count; ++i) {
+            c.guards[i] = c.alphabet[i];
+        }
+        erase(c.alphabet.data(), c.alphabet_length, 0, c.guards_count);
+
+        c.alphabet_length -= c.guards_count;
+    }
+
+    return c;
+}
+
+/* salt for the next shuffle: lottery + salt + current alphabet */
+template <std::size_t N>
+constexpr void
+next_alphabet(std::array<char, N> &current, char lottery, const char *salt,
+    std::size_t salt_prefix) noexcept
+{
+    std::array<char, N> buffer{};
+    std::size_t i;
+
+    buffer[0] = lottery;
+    for (i = 1; i < salt_prefix; ++i) {
+        buffer[i] = salt[i - 1];
+    }
+    for (i = salt_prefix; i < N; ++i) {
+        buffer[i] = current[i - salt_prefix];
+    }
+
+    shuffle(current.data(), N, buffer.data(), N);
+}
+
+} /* namespace detail */
+
+template <fixed_string Salt, std::size_t MinLength,
+    fixed_string Alphabet = HASHIDS_DEFAULT_ALPHABET>
+class static_codec {
+    static constexpr detail::config config_ = detail::make_config(Salt,
+        Alphabet);
+
+    static_assert(config_.error != HASHIDS_ERROR_ALPHABET_LENGTH,
+        "hashids alphabet needs at least 16 unique characters");
+    static_assert(config_.error != HASHIDS_ERROR_ALPHABET_SPACE,
+        "hashids alphabet must not contain spaces or tabs");
+
+public:
+    static constexpr std::size_t alphabet_length = config_.alphabet_length;
+    static constexpr std::size_t separators_count = config_.separators_count;
+    static constexpr std::size_t guards_count = config_.guards_count;
+    static constexpr std::size_t min_hash_length = MinLength;
+    static constexpr std::size_t salt_length = Salt.length();
+
+    static constexpr std::string_view alphabet{config_.alphabet.data(),
+        alphabet_length};
+    static constexpr std::string_view separators{config_.separators.data(),
+        separators_count};
+    static constexpr std::string_view guards{config_.guards.data(),
+        guards_count};
+
+private:
+    using alphabet_t = std::array<char, alphabet_length>;
+
+    /* per-iteration salt length (lottery + salt, capped by the alphabet) */
+    static constexpr std::size_t salt_prefix = salt_length + 1
+        < alphabet_length ? salt_length + 1 : alphabet_length;
+
+    /* byte classes & alphabet positions */
+    static constexpr std::array<unsigned char, 256> classes_ = [] {
+        std::array<unsigned char, 256> classes{};
+
+        for (char ch : alphabet) {
+            classes[static_cast<unsigned char>(ch)] = HASHIDS_CLASS_ALPHABET;
+        }
+        for (char ch : separators) {
+            classes[static_cast<unsigned char>(ch)] = HASHIDS_CLASS_SEPARATOR;
+        }
+        for (char ch : guards) {
+            classes[static_cast<unsigned char>(ch)] = HASHIDS_CLASS_GUARD;
+        }
+
+        return classes;
+    }();
+
+    static constexpr std::array<unsigned char, 256> indexes_ = [] {
+        std::array<unsigned char, 256> indexes{};
+
+        for (auto &index : indexes) {
+            index = HASHIDS_INDEX_NONE;
+        }
+        for (std::size_t i = 0; i < alphabet_length; ++i) {
+            indexes[static_cast<unsigned char>(alphabet[i])] =
+                static_cast<unsigned char>(i);
+        }
+
+        return indexes;
+    }();
+
+    static constexpr void
+    next_alphabet(alphabet_t &current, char lottery) noexcept
+    {
+        detail::next_alphabet(current, lottery, Salt.value, salt_prefix);
+    }
+
+    /* alphabet of the first number for every lottery */
+    static constexpr std::array<alphabet_t, alphabet_length> first_ = [] {
+        std::array<alphabet_t, alphabet_length> first{};
+
+        for (std::size_t i = 0; i < alphabet_length; ++i) {
+            for (std::size_t k = 0; k < alphabet_length; ++k) {
+                first[i][k] = alphabet[k];
+            }
+            next_alphabet(first[i], alphabet[i]);
+        }
+
+        return first;
+    }();
+
+    static constexpr std::size_t
+    digits_count(unsigned long long number) noexcept
+    {
+        std::size_t count = 1;
+
+        while (number >= alphabet_length) {
+            number /= alphabet_length;
+            ++count;
+        }
+
+        return count;
+    }
+
+    /*
+     * Produce the hash byte by byte at its final position.  The sink is
+     * called as sink(position, ch) and may return false to stop early
+     * (used to verify a hash without materializing it).
+     */
+    template <class Sink>
+    static constexpr std::size_t
+    emit(const unsigned long long *numbers, std::size_t numbers_count,
+        Sink &&sink) noexcept
+    {
+        std::size_t i, j, k, result_len, left, right, core, position;
+        unsigned long long number, numbers_hash;
+        alphabet_t current{};
+        char lottery, first_digit, ch;
+        bool guard_before, guard_after;
+
+        /* walk arguments once and generate a hash */
+        for (i = 0, numbers_hash = 0; i < numbers_count; ++i) {
+            numbers_hash += numbers[i] % (i + 100);
+        }
+        lottery = alphabet[numbers_hash % alphabet_length];
+
+        /* lay out the intermediate string: lottery, digits & separators */
+        for (i = 0, result_len = 1; i < numbers_count; ++i) {
+            result_len += digits_count(numbers[i]) + (i + 1 < numbers_count);
+        }
+        core = result_len;
+
+        /* lay out guards and padding */
+        guard_before = result_len < MinLength;
+        result_len += guard_before;
+        guard_after = result_len < MinLength;
+        result_len += guard_after;
+        for (left = 0, j = result_len; j < MinLength; ) {
+            std::size_t l = pad_left(j);
+            left += l;
+            j += l + pad_right(j);
+        }
+        right = j;
+
+        /* the intermediate string */
+        position = left + guard_before;
+        if (!sink(position++, lottery)) {
+            return 0;
+        }
+        current = first_[numbers_hash % alphabet_length];
+        first_digit = lottery;
+        for (i = 0; i < numbers_count; ++i) {
+            if (i) {
+                next_alphabet(current, lottery);
+            }
+
+            number = numbers[i];
+            k = digits_count(number);
+            j = position + k;
+            do {
+                ch = current[number % alphabet_length];
+                if (!sink(--j, ch)) {
+                    return 0;
+                }
+                number /= alphabet_length;
+            } while (number);
+            if (!i) {
+                first_digit = ch;
+            }
+            position += k;
+
+            if (i + 1 < numbers_count) {
+                number = numbers[i] % static_cast<std::size_t>(ch + i);
+                if (!sink(position++, separators[number
+                    % separators_count])) {
+                    return 0;
+                }
+            }
+        }
+
+        /* guards */
+        if (guard_before && !sink(left, guards[(numbers_hash + lottery)
+            % guards_count])) {
+            return 0;
+        }
+        if (guard_after && !sink(left + 1 + core, guards[(numbers_hash
+            + first_digit) % guards_count])) {
+            return 0;
+        }
+
+        /* padding, grown outwards one shuffle at a time */
+        for (i = left, k = left + core + 2, j = core + 2; j < MinLength; ) {
+            std::size_t l = pad_left(j), r = pad_right(j), n;
+            alphabet_t salt = current;
+
+            detail::shuffle(current.data(), alphabet_length, salt.data(),
+                alphabet_length);
+
+            for (n = 0; n < l; ++n) {
+                if (!sink(i - l + n, current[alphabet_length - l + n])) {
+                    return 0;
+                }
+            }
+            for (n = 0; n < r; ++n) {
+                if (!sink(k + n, current[n])) {
+                    return 0;
+                }
+            }
+
+            i -= l;
+            k += r;
+            j += l + r;
+        }
+
+        return right;
+    }
+
+    /* left & right padding added at intermediate length result_len */
+    static constexpr std::size_t
+    pad_left(std::size_t result_len) noexcept
+    {
+        std::size_t i = (MinLength - result_len + 1) / 2;
+
+        if (i > (alphabet_length + 1) / 2) {
+            i = (alphabet_length + 1) / 2;
+        }
+
+        return i + excess(result_len);
+    }
+
+    static constexpr std::size_t
+    pad_right(std::size_t result_len) noexcept
+    {
+        std::size_t j = static_cast<std::size_t>(static_cast<float>(MinLength
+            - result_len) / 2);
+
+        if (j > alphabet_length / 2) {
+            j = alphabet_length / 2;
+        }
+
+        return j - excess(result_len);
+    }
+
+    /* handle excessively excessive excess */
+    static constexpr std::size_t
+    excess(std::size_t result_len) noexcept
+    {
+        std::size_t i = (MinLength - result_len + 1) / 2;
+        std::size_t j = static_cast<std::size_t>(static_cast<float>(MinLength
+            - result_len) / 2);
+
+        if (i > (alphabet_length + 1) / 2) {
+            i = (alphabet_length + 1) / 2;
+        }
+        if (j > alphabet_length / 2) {
+            j = alphabet_length / 2;
+        }
+
+        return (i + j) % 2 == 0 && alphabet_length % 2 == 1;
+    }
+
+public:
+    /* buffer size (terminating NUL included) that always suffices */
+    static constexpr std::size_t
+    max_encoded_size(std::size_t numbers_count) noexcept
+    {
+        std::size_t result_len = numbers_count ? numbers_count
+            * (digits_count(~0ull) + 1) : 1;
+
+        return (result_len < MinLength ? MinLength : result_len) + 1;
+    }
+
+    /* encode many, returns the hash length */
+    static constexpr std::size_t
+    encode(char *buffer, const unsigned long long *numbers,
+        std::size_t numbers_count) noexcept
+    {
+        std::size_t result_len;
+
+        if (!numbers_count) {
+            buffer[0] = '\0';
+            return 0;
+        }
+
+        result_len = emit(numbers, numbers_count,
+            [buffer](std::size_t position, char ch) {
+                buffer[position] = ch;
+                return true;
+            });
+        buffer[result_len] = '\0';
+
+        return result_len;
+    }
+
+    /* encode one */
+    static constexpr std::size_t
+    encode_one(char *buffer, unsigned long long number) noexcept
+    {
+        return encode(buffer, &number, 1);
+    }
+
+    /* decode, returns the numbers count or 0 for an invalid hash */
+    static constexpr std::size_t
+    decode(std::string_view str, unsigned long long *numbers,
+        std::size_t numbers_max) noexcept
+    {
+        std::size_t i, numbers_count;
+        unsigned long long number;
+        alphabet_t current{};
+        unsigned char cls;
+        char lottery;
+
+        if (!numbers_max) {
+            return 0;
+        }
+
+        /* skip characters until we find a guard */
+        if (MinLength) {
+            for (i = 0; i < str.size(); ++i) {
+                if (classes_[static_cast<unsigned char>(str[i])]
+                    == HASHIDS_CLASS_GUARD) {
+                    str.remove_prefix(i + 1);
+                    break;
+                }
+            }
+        }
+
+        /* get the lottery character */
+        if (str.empty()) {
+            return 0;
+        }
+        lottery = str[0];
+        str.remove_prefix(1);
+
+        /* first alphabet */
+        if (indexes_[static_cast<unsigned char>(lottery)]
+            != HASHIDS_INDEX_NONE) {
+            current = first_[indexes_[static_cast<unsigned char>(lottery)]];
+        } else {
+            for (i = 0; i < alphabet_length; ++i) {
+                current[i] = alphabet[i];
+            }
+            next_alphabet(current, lottery);
+        }
+
+        /* parse */
+        for (i = 0, numbers_count = 0, number = 0; i < str.size(); ++i) {
+            cls = classes_[static_cast<unsigned char>(str[i])];
+            if (cls == HASHIDS_CLASS_ALPHABET) {
+                number *= alphabet_length;
+                number += detail::find(current.data(), alphabet_length,
+                    str[i]);
+                continue;
+            }
+            if (cls == HASHIDS_CLASS_SEPARATOR) {
+                numbers[numbers_count] = number;
+                if (++numbers_count >= numbers_max) {
+                    return numbers_count;
+                }
+
+                number = 0;
+                next_alphabet(current, lottery);
+                continue;
+            }
+            if (cls == HASHIDS_CLASS_GUARD) {
+                break;
+            }
+
+            return 0;
+        }
+
+        /* store last number */
+        numbers[numbers_count] = number;
+
+        return numbers_count + 1;
+    }
+
+    /* decode and check that the hash is the canonical encoding */
+    static constexpr std::size_t
+    decode_safe(std::string_view str, unsigned long long *numbers,
+        std::size_t numbers_max) noexcept
+    {
+        std::size_t numbers_count, result_len;
+
+        numbers_count = decode(str, numbers, numbers_max);
+        if (!numbers_count) {
+            return 0;
+        }
+
+        result_len = emit(numbers, numbers_count,
+            [str](std::size_t position, char ch) {
+                return position < str.size() && str[position] == ch;
+            });
+
+        return result_len == str.size() ? numbers_count : 0;
+    }
+};
+
+} /* namespace hashids */
+
+#endif
@@ -0,0 +1,429 @@
+/*
+ * hashids microbenchmarks: ns/op and ops/sec for init, snapshot load,
+ * encode, decode, safe decode (plain and through the decode cache) and the
+ * hex helpers across alphabet sizes, salt lengths, minimum hash lengths and
+ * number magnitudes.
+ *
+ * Build (Linux / macOS):
+ *
+ *   cc -O2 -I../../Covid/AdditionalInfo -o hashids_bench hashids_bench.c \
+ *       ../../Covid/AdditionalInfo/hashids.c -lm
+ *
+ * Usage:
+ *
+ *   hashids_bench [-j] [-t milliseconds] [-f operation]
+ *
+ *   -j  print one JSON document instead of a table
+ *   -t  minimum measuring time per case (default 20)
+ *   -f  only run operations whose name contains this string
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hashids.h"
+
+/* inputs per case, cycled through by every operation */
+#define BENCH_INPUTS 1024
+
+/* the app's configuration (see IdentityViewController.swift) */
+#define BENCH_APP_SALT "COVID-19 super-secure and unguessable hashids salt"
+#define BENCH_APP_ALPHABET "ABCDEFGHJKLMNPQRSTUVXYZ23456789"
+
+struct bench_alphabet {
+    const char *name;
+    const char *alphabet;
+};
+
+static const struct bench_alphabet bench_alphabets[] = {
+    { "hex", "0123456789abcdef" },
+    { "app", BENCH_APP_ALPHABET },
+    { "default", HASHIDS_DEFAULT_ALPHABET },
+    { "printable", "!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVW"
+        "XYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~" }
+};
+
+static const size_t bench_salt_lengths[] = { 0, 16, 50, 200 };
+
+static const size_t bench_min_lengths[] = { 0, 6, 24 };
+
+struct bench_magnitude {
+    const char *name;
+    unsigned long long mask;
+};
+
+static const struct bench_magnitude bench_magnitudes[] = {
+    { "small", 0x3FFull },
+    { "u32", 0xFFFFFFFFull },
+    { "u64", ~0ull }
+};
+
+#define BENCH_COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/* the current case */
+struct bench_case {
+    const struct bench_alphabet *alphabet;
+    const char *salt;
+    size_t salt_length;
+    size_t min_hash_length;
+    const struct bench_magnitude *magnitude;
+    unsigned char snapshot[1024];
+    size_t snapshot_size;
+
+    hashids_t *hashids;
+    hashids_decode_cache_t *cache;
+    unsigned long long numbers[BENCH_INPUTS][4];
+    char hashes[BENCH_INPUTS][128];
+    char multi_hashes[BENCH_INPUTS][512];
+    char hex[BENCH_INPUTS][20];
+    char hex_hashes[BENCH_INPUTS][128];
+};
+
+/* options */
+static int bench_json;
+static unsigned long bench_time_ms = 20;
+static const char *bench_filter;
+static size_t bench_results;
+
+/* defeats dead code elimination */
+static volatile size_t bench_sink;
+
+/* xorshift64* */
+static unsigned long long bench_state = 0x9E3779B97F4A7C15ull;
+
+static unsigned long long
+bench_random(void)
+{
+    bench_state ^= bench_state >> 12;
+    bench_state ^= bench_state << 25;
+    bench_state ^= bench_state >> 27;
+    return bench_state * 0x2545F4914F6CDD1Dull;
+}
+
+static double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* operations; each does `iterations` calls cycling through the inputs */
+typedef void (*bench_op_f)(struct bench_case *bc, size_t iterations);
+
+static void
+bench_init(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    hashids_t *hashids;
+
+    for (i = 0; i < iterations; ++i) {
+        hashids = hashids_init3(bc->salt, bc->min_hash_length,
+            bc->alphabet->alphabet);
+        bench_sink += hashids->alphabet_length;
+        hashids_free(hashids);
+    }
+}
+
+static void
+bench_load(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    hashids_t *hashids;
+
+    for (i = 0; i < iterations; ++i) {
+        hashids = hashids_snapshot_load(bc->snapshot, bc->snapshot_size,
+            NULL);
+        bench_sink += hashids->alphabet_length;
+        hashids_free(hashids);
+    }
+}
+
+static void
+bench_encode_one(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    char buffer[128];
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_encode_one(bc->hashids, buffer,
+            bc->numbers[i % BENCH_INPUTS][0]);
+    }
+}
+
+static void
+bench_encode(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    char buffer[512];
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_encode(bc->hashids, buffer, 4,
+            bc->numbers[i % BENCH_INPUTS]);
+    }
+}
+
+static void
+bench_decode(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    unsigned long long numbers[4];
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_decode(bc->hashids,
+            bc->multi_hashes[i % BENCH_INPUTS], numbers, 4);
+    }
+}
+
+static void
+bench_decode_safe(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    unsigned long long numbers[4];
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_decode_safe(bc->hashids,
+            bc->multi_hashes[i % BENCH_INPUTS], numbers, 4);
+    }
+}
+
+static void
+bench_decode_cached(struct bench_case *bc, size_t iterations)
+{
+    size_t i, count;
+    unsigned long long numbers[4];
+    hashids_ctx_t ctx;
+
+    for (i = 0; i < iterations; ++i) {
+        hashids_decode_cached_s(bc->cache, &ctx,
+            bc->multi_hashes[i % BENCH_INPUTS], numbers, 4, &count);
+        bench_sink += count;
+    }
+}
+
+static void
+bench_decode_one(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    unsigned long long number;
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_decode(bc->hashids,
+            bc->hashes[i % BENCH_INPUTS], &number, 1);
+    }
+}
+
+static void
+bench_encode_hex(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    char buffer[128];
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_encode_hex(bc->hashids, buffer,
+            bc->hex[i % BENCH_INPUTS]);
+    }
+}
+
+static void
+bench_decode_hex(struct bench_case *bc, size_t iterations)
+{
+    size_t i;
+    char buffer[20];
+
+    for (i = 0; i < iterations; ++i) {
+        bench_sink += hashids_decode_hex(bc->hashids,
+            bc->hex_hashes[i % BENCH_INPUTS], buffer);
+    }
+}
+
+struct bench_op {
+    const char *name;
+    bench_op_f run;
+    int per_number;     /* depends on min length & magnitude */
+};
+
+static const struct bench_op bench_ops[] = {
+    { "init", bench_init, 0 },
+    { "load", bench_load, 0 },
+    { "encode_one", bench_encode_one, 1 },
+    { "encode4", bench_encode, 1 },
+    { "decode_one", bench_decode_one, 1 },
+    { "decode4", bench_decode, 1 },
+    { "decode_safe4", bench_decode_safe, 1 },
+    { "decode_cached4", bench_decode_cached, 1 },
+    { "encode_hex", bench_encode_hex, 1 },
+    { "decode_hex", bench_decode_hex, 1 }
+};
+
+/* fill the case inputs for the current magnitude */
+static void
+bench_prepare(struct bench_case *bc)
+{
+    size_t i, k;
+
+    for (i = 0; i < BENCH_INPUTS; ++i) {
+        for (k = 0; k < 4; ++k) {
+            bc->numbers[i][k] = bench_random() & bc->magnitude->mask;
+        }
+        hashids_encode_one(bc->hashids, bc->hashes[i], bc->numbers[i][0]);
+        hashids_encode(bc->hashids, bc->multi_hashes[i], 4, bc->numbers[i]);
+
+        /* up to 15 hex digits: one or two HASHIDS_HEX_CHUNK numbers */
+        snprintf(bc->hex[i], sizeof(bc->hex[i]), "%llx",
+            bc->numbers[i][0] & 0x0FFFFFFFFFFFFFFFull);
+        hashids_encode_hex(bc->hashids, bc->hex_hashes[i], bc->hex[i]);
+    }
+}
+
+/* time one operation: grow the iteration count until the budget is met */
+static void
+bench_run(struct bench_case *bc, const struct bench_op *op)
+{
+    size_t iterations;
+    double start, elapsed, ns_per_op;
+
+    if (bench_filter && !strstr(op->name, bench_filter)) {
+        return;
+    }
+
+    /* warm up */
+    op->run(bc, 16);
+
+    for (iterations = 64; ; iterations *= 2) {
+        start = bench_now();
+        op->run(bc, iterations);
+        elapsed = bench_now() - start;
+        if (elapsed >= bench_time_ms * 1e6 || iterations >= ((size_t)1 << 40)) {
+            break;
+        }
+    }
+    ns_per_op = elapsed / (double)iterations;
+
+    if (bench_json) {
+        printf("%s\n    {\"op\": \"%s\", \"alphabet\": \"%s\", "
+            "\"alphabet_length\": %zu, \"salt_length\": %zu, "
+            "\"min_hash_length\": %zu, \"magnitude\": \"%s\", "
+            "\"iterations\": %zu, \"ns_per_op\": %.2f, "
+            "\"ops_per_sec\": %.0f}",
+            bench_results ? "," : "", op->name, bc->alphabet->name,
+            strlen(bc->alphabet->alphabet), bc->salt_length,
+            op->per_number ? bc->min_hash_length : 0,
+            op->per_number ? bc->magnitude->name : "-", iterations,
+            ns_per_op, 1e9 / ns_per_op);
+    } else {
+        printf("%-14s %-10s %5zu %6zu %5zu %-6s %12.2f %14.0f\n", op->name,
+            bc->alphabet->name, strlen(bc->alphabet->alphabet),
+            bc->salt_length, op->per_number ? bc->min_hash_length : 0,
+            op->per_number ? bc->magnitude->name : "-", ns_per_op,
+            1e9 / ns_per_op);
+    }
+    ++bench_results;
+    fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+    static struct bench_case bc;
+    char salt[256];
+    size_t a, s, m, g, o;
+    int ch;
+
+    while ((ch = getopt(argc, argv, "jt:f:")) != -1) {
+        switch (ch) {
+            case 'j':
+                bench_json = 1;
+                break;
+            case 't':
+                bench_time_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                bench_filter = optarg;
+                break;
+            default:
+                fprintf(stderr,
+                    "usage: %s [-j] [-t milliseconds] [-f operation]\n",
+                    argv[0]);
+                return 1;
+        }
+    }
+
+    if (bench_json) {
+        printf("{\n  \"hashids_version\": \"%s\",\n  \"results\": [",
+            HASHIDS_VERSION);
+    } else {
+        printf("%-14s %-10s %5s %6s %5s %-6s %12s %14s\n", "op", "alphabet",
+            "alen", "salt", "min", "magn", "ns/op", "ops/sec");
+    }
+
+    for (a = 0; a < BENCH_COUNT(bench_alphabets); ++a) {
+        for (s = 0; s < BENCH_COUNT(bench_salt_lengths); ++s) {
+            /* the app's salt, repeated or cut to length */
+            for (g = 0; g < bench_salt_lengths[s]; ++g) {
+                salt[g] = BENCH_APP_SALT[g % (sizeof(BENCH_APP_SALT) - 1)];
+            }
+            salt[g] = '\0';
+
+            bc.alphabet = &bench_alphabets[a];
+            bc.salt = salt;
+            bc.salt_length = bench_salt_lengths[s];
+            bc.min_hash_length = 0;
+
+            /* init & load do not depend on min length or magnitude */
+            bench_run(&bc, &bench_ops[0]);
+            bc.hashids = hashids_init3(bc.salt, 0, bc.alphabet->alphabet);
+            if (!bc.hashids) {
+                fprintf(stderr, "hashids_init3 failed: %d\n", hashids_errno);
+                return 1;
+            }
+            bc.snapshot_size = hashids_snapshot_save(bc.hashids, bc.snapshot,
+                sizeof(bc.snapshot));
+            hashids_free(bc.hashids);
+            bench_run(&bc, &bench_ops[1]);
+
+            for (g = 0; g < BENCH_COUNT(bench_min_lengths); ++g) {
+                bc.min_hash_length = bench_min_lengths[g];
+                bc.hashids = hashids_init3(bc.salt, bc.min_hash_length,
+                    bc.alphabet->alphabet);
+                if (!bc.hashids) {
+                    fprintf(stderr, "hashids_init3 failed: %d\n",
+                        hashids_errno);
+                    return 1;
+                }
+                /* room for every input: a hit rate near 100% */
+                bc.cache = hashids_decode_cache_create(bc.hashids,
+                    BENCH_INPUTS * 2);
+                if (!bc.cache) {
+                    fprintf(stderr, "hashids_decode_cache_create failed: "
+                        "%d\n", hashids_errno);
+                    return 1;
+                }
+
+                for (m = 0; m < BENCH_COUNT(bench_magnitudes); ++m) {
+                    bc.magnitude = &bench_magnitudes[m];
+                    bench_prepare(&bc);
+
+                    for (o = 2; o < BENCH_COUNT(bench_ops); ++o) {
+                        bench_run(&bc, &bench_ops[o]);
+                    }
+                }
+
+                hashids_decode_cache_free(bc.cache);
+                hashids_free(bc.hashids);
+            }
+        }
+    }
+
+    if (bench_json) {
+        printf("\n  ]\n}\n");
+    }
+
+    return 0;
+}
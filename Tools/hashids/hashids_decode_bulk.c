@@ -0,0 +1,634 @@
+/*
+ * Bulk hashids decoder: reads one hash per line from a file, safe-decodes
+ * them in place on a work-stealing thread pool and writes the IDs as raw
+ * little-endian u64 in input order.  Lines that are not a valid hash of
+ * exactly one number go to the reject list (line number, reason, text)
+ * and produce no output.  Throughput goes to stderr.
+ *
+ * Build (Linux / macOS):
+ *
+ *   cc -O2 -pthread -I../../Covid/AdditionalInfo -o hashids_decode_bulk \
+ *       hashids_decode_bulk.c ../../Covid/AdditionalInfo/hashids.c -lm
+ *
+ * Usage:
+ *
+ *   hashids_decode_bulk [-s salt] [-m min_length] [-a alphabet]
+ *       [-j threads] [-c cache_depth] [-p padding_depth] [-o output]
+ *       [-r rejects] input
+ *
+ *   -s, -m, -a  codec configuration (default: the app's)
+ *   -j  worker threads (default: online CPUs)
+ *   -c  precompute this many shuffles per lottery (hashids_cache_shuffles)
+ *   -p  precompute padding for hashes of up to this many numbers
+ *       (hashids_cache_padding)
+ *   -o  output file (default: stdout)
+ *   -r  reject list (default: stderr)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hashids.h"
+
+/* the app's configuration (see IdentityViewController.swift) */
+#define BULK_APP_SALT "COVID-19 super-secure and unguessable hashids salt"
+#define BULK_APP_MIN_LENGTH 6
+#define BULK_APP_ALPHABET "ABCDEFGHJKLMNPQRSTUVXYZ23456789"
+
+/* bytes per chunk (extended to the end of the line) */
+#define BULK_TEXT_CHUNK (1u << 20)
+
+/* hashes per hashids_decode_safe_batch call */
+#define BULK_BATCH 4096u
+
+/* chunks per worker and round */
+#define BULK_ROUND_FACTOR 4u
+
+/* reject reasons */
+#define BULK_REJECT_INVALID 0       /* not a hash this codec produces */
+#define BULK_REJECT_COUNT 1         /* valid, but not exactly one number */
+
+/* a worker's share of a round; others steal from it once theirs is done */
+struct bulk_range {
+    atomic_size_t next;
+    size_t end;
+    char padding[64 - sizeof(atomic_size_t) - sizeof(size_t)];
+};
+
+/* a rejected line, relative to its chunk */
+struct bulk_reject {
+    size_t line;
+    size_t offset;
+    size_t length;
+    int reason;
+};
+
+/* one decoded chunk, kept until written */
+struct bulk_output {
+    unsigned long long *ids;
+    size_t ids_capacity;
+    size_t ids_count;
+    struct bulk_reject *rejects;
+    size_t rejects_capacity;
+    size_t rejects_count;
+    size_t lines;
+};
+
+struct bulk_job {
+    const hashids_t *hashids;
+    const char *input;
+    size_t input_size;
+
+    /* chunking */
+    size_t chunks_count;
+    size_t *text_bounds;            /* chunks_count + 1 offsets */
+
+    /* the current round */
+    size_t round_first;
+    size_t round_count;
+    struct bulk_output *outputs;    /* this round's slots */
+    struct bulk_range *ranges;
+    size_t threads_count;
+
+    /* round hand-off */
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    size_t active;
+    int quit;
+
+    /* out of memory in a worker */
+    atomic_int failed;
+};
+
+struct bulk_worker {
+    struct bulk_job *job;
+    size_t index;
+    hashids_ctx_t ctx;
+
+    /* one batch of lines */
+    size_t offsets[BULK_BATCH];
+    size_t lengths[BULK_BATCH];
+    unsigned long long numbers[BULK_BATCH];
+    size_t numbers_counts[BULK_BATCH];
+    int statuses[BULK_BATCH];
+};
+
+static double
+bulk_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* grow an array to hold at least `count` elements */
+static int
+bulk_reserve(void **array, size_t *capacity, size_t count, size_t size)
+{
+    void *grown;
+    size_t want;
+
+    if (count <= *capacity) {
+        return 1;
+    }
+    want = *capacity ? *capacity * 2 : 1024;
+    if (want < count) {
+        want = count;
+    }
+    grown = realloc(*array, want * size);
+    if (!grown) {
+        return 0;
+    }
+    *array = grown;
+    *capacity = want;
+    return 1;
+}
+
+/* decode one batch of lines and append the results to the chunk output */
+static int
+bulk_decode_batch(struct bulk_job *job, struct bulk_worker *worker,
+    struct bulk_output *output, size_t first_line, size_t count)
+{
+    const unsigned long long *numbers;
+    unsigned long long id;
+    struct bulk_reject *reject;
+    size_t done, decoded, i, k;
+    unsigned char *bytes;
+    static const union { unsigned short s; unsigned char c; } endian = { 1 };
+
+    if (!bulk_reserve((void **)&output->ids, &output->ids_capacity,
+        output->ids_count + count, sizeof(*output->ids))) {
+        return 0;
+    }
+
+    for (done = 0; done < count; done += decoded) {
+        decoded = hashids_decode_safe_batch(job->hashids, &worker->ctx,
+            job->input, count - done, worker->offsets + done,
+            worker->lengths + done, worker->numbers, BULK_BATCH,
+            worker->numbers_counts + done, worker->statuses + done);
+
+        /* the batch stops short only at a hash verified canonical whose
+           numbers outnumber a whole batch (garbage is rejected in place):
+           valid, but certainly not a single ID */
+        if (!decoded) {
+            worker->numbers_counts[done] = 0;
+            worker->statuses[done] = HASHIDS_ERROR_OK;
+            decoded = 1;
+        }
+
+        numbers = worker->numbers;
+        for (i = done; i < done + decoded; ++i) {
+            if (worker->statuses[i] == HASHIDS_ERROR_OK
+                && worker->numbers_counts[i] == 1) {
+                id = *numbers;
+                if (!endian.c) {
+                    bytes = (unsigned char *)&output->ids[output->ids_count];
+                    for (k = 0; k < 8; ++k, id >>= 8) {
+                        bytes[k] = (unsigned char)id;
+                    }
+                } else {
+                    output->ids[output->ids_count] = id;
+                }
+                ++output->ids_count;
+            } else {
+                if (!bulk_reserve((void **)&output->rejects,
+                    &output->rejects_capacity, output->rejects_count + 1,
+                    sizeof(*output->rejects))) {
+                    return 0;
+                }
+                reject = &output->rejects[output->rejects_count++];
+                reject->line = first_line + i;
+                reject->offset = worker->offsets[i];
+                reject->length = worker->lengths[i];
+                reject->reason = worker->statuses[i] == HASHIDS_ERROR_OK
+                    ? BULK_REJECT_COUNT : BULK_REJECT_INVALID;
+            }
+            numbers += worker->numbers_counts[i];
+        }
+    }
+
+    return 1;
+}
+
+/* decode one chunk into its output slot, straight from the mapping */
+static void
+bulk_decode_chunk(struct bulk_job *job, struct bulk_worker *worker,
+    size_t chunk)
+{
+    struct bulk_output *output;
+    const char *p, *line_end, *stop;
+    size_t count, lines;
+
+    output = &job->outputs[chunk - job->round_first];
+    output->ids_count = 0;
+    output->rejects_count = 0;
+
+    count = 0;
+    lines = 0;
+    stop = job->input + job->text_bounds[chunk + 1];
+    for (p = job->input + job->text_bounds[chunk]; p < stop;
+        p = line_end + 1) {
+        line_end = memchr(p, '\n', stop - p);
+        if (!line_end) {
+            line_end = stop;
+        }
+
+        /* tolerate CRLF */
+        worker->offsets[count] = p - job->input;
+        worker->lengths[count] = line_end - p
+            - (line_end > p && line_end[-1] == '\r');
+
+        if (++count == BULK_BATCH) {
+            if (!bulk_decode_batch(job, worker, output, lines, count)) {
+                atomic_store(&job->failed, 1);
+                return;
+            }
+            lines += count;
+            count = 0;
+        }
+    }
+    if (count && !bulk_decode_batch(job, worker, output, lines, count)) {
+        atomic_store(&job->failed, 1);
+        return;
+    }
+    output->lines = lines + count;
+}
+
+/* claim chunks: own range first, then steal */
+static void
+bulk_work(struct bulk_worker *worker)
+{
+    struct bulk_job *job;
+    struct bulk_range *range;
+    size_t v, chunk;
+
+    job = worker->job;
+    for (v = 0; v < job->threads_count; ++v) {
+        range = &job->ranges[(worker->index + v) % job->threads_count];
+        while ((chunk = atomic_fetch_add(&range->next, 1)) < range->end) {
+            if (atomic_load(&job->failed)) {
+                return;
+            }
+            bulk_decode_chunk(job, worker, chunk);
+        }
+    }
+}
+
+static void *
+bulk_thread(void *arg)
+{
+    struct bulk_worker *worker;
+    struct bulk_job *job;
+    unsigned long seen;
+
+    worker = (struct bulk_worker *)arg;
+    job = worker->job;
+    seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->generation == seen && !job->quit) {
+            pthread_cond_wait(&job->start, &job->lock);
+        }
+        if (job->quit) {
+            pthread_mutex_unlock(&job->lock);
+            return NULL;
+        }
+        seen = job->generation;
+        pthread_mutex_unlock(&job->lock);
+
+        bulk_work(worker);
+
+        pthread_mutex_lock(&job->lock);
+        if (--job->active == 0) {
+            pthread_cond_signal(&job->done);
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+/* split a round's chunks into one contiguous range per worker and go */
+static void
+bulk_start_round(struct bulk_job *job, size_t first, size_t count,
+    struct bulk_output *outputs)
+{
+    size_t t, share, begin;
+
+    job->round_first = first;
+    job->round_count = count;
+    job->outputs = outputs;
+
+    for (t = 0, begin = first; t < job->threads_count; ++t) {
+        share = count / job->threads_count + (t < count % job->threads_count);
+        atomic_store(&job->ranges[t].next, begin);
+        job->ranges[t].end = begin + share;
+        begin += share;
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->active = job->threads_count;
+    ++job->generation;
+    pthread_cond_broadcast(&job->start);
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void
+bulk_wait_round(struct bulk_job *job)
+{
+    pthread_mutex_lock(&job->lock);
+    while (job->active) {
+        pthread_cond_wait(&job->done, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+/* split the input into ~BULK_TEXT_CHUNK pieces of whole lines */
+static size_t *
+bulk_text_bounds(const char *input, size_t size, size_t *chunks_count)
+{
+    size_t *bounds, count, offset, next;
+    const char *newline;
+
+    bounds = malloc((size / BULK_TEXT_CHUNK + 2) * sizeof(*bounds));
+    if (!bounds) {
+        return NULL;
+    }
+
+    bounds[0] = 0;
+    for (count = 0, offset = 0; offset < size; offset = next) {
+        next = offset + BULK_TEXT_CHUNK;
+        if (next >= size) {
+            next = size;
+        } else {
+            /* extend to the end of the line */
+            newline = memchr(input + next - 1, '\n', size - next + 1);
+            next = newline ? (size_t)(newline - input) + 1 : size;
+        }
+        bounds[++count] = next;
+    }
+
+    *chunks_count = count;
+    return bounds;
+}
+
+/* write a decoded chunk: IDs to the output, rejects with absolute line
+   numbers to the reject list */
+static int
+bulk_write_chunk(const struct bulk_job *job, const struct bulk_output *output,
+    size_t line_base, FILE *out, FILE *rejects)
+{
+    const struct bulk_reject *reject;
+    size_t i;
+    int status;
+
+    status = 0;
+    if (fwrite(output->ids, sizeof(*output->ids), output->ids_count, out)
+        != output->ids_count) {
+        status = 1;
+    }
+    for (i = 0; i < output->rejects_count; ++i) {
+        reject = &output->rejects[i];
+        if (fprintf(rejects, "%zu\t%s\t", line_base + reject->line + 1,
+                reject->reason == BULK_REJECT_COUNT ? "count" : "invalid") < 0
+            || fwrite(job->input + reject->offset, 1, reject->length, rejects)
+                != reject->length
+            || putc('\n', rejects) == EOF) {
+            status = 1;
+        }
+    }
+
+    return status;
+}
+
+static int
+bulk_usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-s salt] [-m min_length] [-a alphabet] "
+        "[-j threads] [-c cache_depth] [-p padding_depth] [-o output] "
+        "[-r rejects] input\n",
+        name);
+    return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bulk_job job;
+    struct bulk_worker *workers;
+    struct bulk_output *slots[2], *output;
+    pthread_t *threads;
+    const char *salt, *alphabet, *output_path, *rejects_path;
+    size_t min_length, cache_depth, padding_depth, round_size, first, count,
+        previous_first, previous_count, lines, ids, rejected, i, t;
+    hashids_t *hashids;
+    struct stat st;
+    FILE *out, *rejects;
+    double start, elapsed;
+    int ch, fd, status;
+    long cpus;
+
+    memset(&job, 0, sizeof(job));
+    salt = BULK_APP_SALT;
+    alphabet = BULK_APP_ALPHABET;
+    min_length = BULK_APP_MIN_LENGTH;
+    output_path = NULL;
+    rejects_path = NULL;
+    cache_depth = 0;
+    padding_depth = 0;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    job.threads_count = cpus > 0 ? (size_t)cpus : 1;
+
+    while ((ch = getopt(argc, argv, "s:m:a:j:c:p:o:r:")) != -1) {
+        switch (ch) {
+            case 's':
+                salt = optarg;
+                break;
+            case 'm':
+                min_length = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                alphabet = optarg;
+                break;
+            case 'j':
+                job.threads_count = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                cache_depth = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                padding_depth = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case 'r':
+                rejects_path = optarg;
+                break;
+            default:
+                return bulk_usage(argv[0]);
+        }
+    }
+    if (optind + 1 != argc || !job.threads_count) {
+        return bulk_usage(argv[0]);
+    }
+
+    /* the codec, shared read-only by all workers */
+    hashids = hashids_init3(salt, min_length, alphabet);
+    if (!hashids) {
+        fprintf(stderr, "hashids_init3: error %d\n", hashids_errno);
+        return 1;
+    }
+    if (cache_depth && hashids_cache_shuffles(hashids, cache_depth)) {
+        fprintf(stderr, "hashids_cache_shuffles: error %d\n", hashids_errno);
+        return 1;
+    }
+    if (padding_depth && hashids_cache_padding(hashids, padding_depth)) {
+        fprintf(stderr, "hashids_cache_padding: error %d\n", hashids_errno);
+        return 1;
+    }
+    job.hashids = hashids;
+
+    /* map the input */
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    job.input_size = (size_t)st.st_size;
+    job.input = "";
+    if (job.input_size) {
+        job.input = mmap(NULL, job.input_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (job.input == MAP_FAILED) {
+            fprintf(stderr, "mmap: %s\n", strerror(errno));
+            return 1;
+        }
+#ifdef POSIX_MADV_SEQUENTIAL
+        posix_madvise((void *)job.input, job.input_size,
+            POSIX_MADV_SEQUENTIAL);
+#endif
+    }
+
+    job.text_bounds = bulk_text_bounds(job.input, job.input_size,
+        &job.chunks_count);
+    if (!job.text_bounds) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    out = output_path ? fopen(output_path, "wb") : stdout;
+    if (!out) {
+        fprintf(stderr, "%s: %s\n", output_path, strerror(errno));
+        return 1;
+    }
+    rejects = rejects_path ? fopen(rejects_path, "w") : stderr;
+    if (!rejects) {
+        fprintf(stderr, "%s: %s\n", rejects_path, strerror(errno));
+        return 1;
+    }
+
+    /* pool */
+    round_size = job.threads_count * BULK_ROUND_FACTOR;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.start, NULL);
+    pthread_cond_init(&job.done, NULL);
+    job.ranges = calloc(job.threads_count, sizeof(*job.ranges));
+    slots[0] = calloc(round_size, sizeof(**slots));
+    slots[1] = calloc(round_size, sizeof(**slots));
+    workers = calloc(job.threads_count, sizeof(*workers));
+    threads = calloc(job.threads_count, sizeof(*threads));
+    if (!job.ranges || !slots[0] || !slots[1] || !workers || !threads) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (t = 0; t < job.threads_count; ++t) {
+        workers[t].job = &job;
+        workers[t].index = t;
+        if (pthread_create(&threads[t], NULL, bulk_thread, &workers[t])) {
+            fprintf(stderr, "cannot start worker %zu\n", t);
+            return 1;
+        }
+    }
+
+    /* decode round r while writing round r - 1 */
+    start = bulk_now();
+    status = 0;
+    lines = 0;
+    ids = 0;
+    rejected = 0;
+    previous_first = 0;
+    previous_count = 0;
+    for (first = 0; ; first += count) {
+        count = job.chunks_count - first;
+        if (count > round_size) {
+            count = round_size;
+        }
+        if (count) {
+            bulk_start_round(&job, first, count, slots[(first / round_size)
+                % 2]);
+        }
+
+        for (i = 0; i < previous_count; ++i) {
+            output = &slots[(previous_first / round_size) % 2][i];
+            if (bulk_write_chunk(&job, output, lines, out, rejects)) {
+                fprintf(stderr, "write: %s\n", strerror(errno));
+                status = 1;
+            }
+            lines += output->lines;
+            ids += output->ids_count;
+            rejected += output->rejects_count;
+        }
+
+        if (!count) {
+            break;
+        }
+        bulk_wait_round(&job);
+        if (atomic_load(&job.failed)) {
+            break;
+        }
+        previous_first = first;
+        previous_count = count;
+    }
+    if (fflush(out) || fflush(rejects)) {
+        fprintf(stderr, "write: %s\n", strerror(errno));
+        status = 1;
+    }
+    elapsed = bulk_now() - start;
+
+    /* shut the pool down */
+    pthread_mutex_lock(&job.lock);
+    job.quit = 1;
+    pthread_cond_broadcast(&job.start);
+    pthread_mutex_unlock(&job.lock);
+    for (t = 0; t < job.threads_count; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    if (atomic_load(&job.failed)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    /* throughput */
+    fprintf(stderr, "%zu lines (%zu bytes) in %.3f s with %zu threads: "
+        "%zu ids, %zu rejected, %.0f lines/s, %.1f MB/s\n", lines,
+        job.input_size, elapsed, job.threads_count, ids, rejected,
+        elapsed > 0 ? lines / elapsed : 0.0,
+        elapsed > 0 ? job.input_size / elapsed / 1e6 : 0.0);
+
+    hashids_free(hashids);
+    return status;
+}
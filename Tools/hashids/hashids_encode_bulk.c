@@ -0,0 +1,595 @@
+/*
+ * Bulk hashids encoder: reads IDs from a file (raw little-endian u64 or
+ * one decimal per line), encodes them on a work-stealing thread pool and
+ * writes one hash per line in input order.  Throughput goes to stderr.
+ *
+ * Build (Linux / macOS):
+ *
+ *   cc -O2 -pthread -I../../Covid/AdditionalInfo -o hashids_encode_bulk \
+ *       hashids_encode_bulk.c ../../Covid/AdditionalInfo/hashids.c -lm
+ *
+ * Usage:
+ *
+ *   hashids_encode_bulk [-b] [-s salt] [-m min_length] [-a alphabet]
+ *       [-j threads] [-c cache_depth] [-p padding_depth] [-o output]
+ *       input
+ *
+ *   -b  input is raw little-endian u64 (default: decimal lines)
+ *   -s, -m, -a  codec configuration (default: the app's)
+ *   -j  worker threads (default: online CPUs)
+ *   -c  precompute this many shuffles per lottery (hashids_cache_shuffles)
+ *   -p  precompute padding for hashes of up to this many numbers
+ *       (hashids_cache_padding)
+ *   -o  output file (default: stdout)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hashids.h"
+
+/* the app's configuration (see IdentityViewController.swift) */
+#define BULK_APP_SALT "COVID-19 super-secure and unguessable hashids salt"
+#define BULK_APP_MIN_LENGTH 6
+#define BULK_APP_ALPHABET "ABCDEFGHJKLMNPQRSTUVXYZ23456789"
+
+/* chunk sizes: IDs per binary chunk, bytes per text chunk */
+#define BULK_BINARY_CHUNK 65536u
+#define BULK_TEXT_CHUNK (1u << 20)
+
+/* chunks per worker and round */
+#define BULK_ROUND_FACTOR 4u
+
+/* a worker's share of a round; others steal from it once theirs is done */
+struct bulk_range {
+    atomic_size_t next;
+    size_t end;
+    char padding[64 - sizeof(atomic_size_t) - sizeof(size_t)];
+};
+
+/* one encoded chunk, kept until written */
+struct bulk_output {
+    char *buffer;
+    size_t capacity;
+    size_t length;
+    size_t count;
+};
+
+struct bulk_job {
+    const hashids_t *hashids;
+    int binary;
+    const char *input;
+    size_t input_size;
+
+    /* chunking */
+    size_t chunks_count;
+    size_t *text_bounds;            /* chunks_count + 1 offsets */
+    size_t bound;                   /* worst-case bytes per hash, NUL incl. */
+
+    /* the current round */
+    size_t round_first;
+    size_t round_count;
+    struct bulk_output *outputs;    /* this round's slots */
+    struct bulk_range *ranges;
+    size_t threads_count;
+
+    /* round hand-off */
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    size_t active;
+    int quit;
+
+    /* first input error, as a byte offset */
+    atomic_int failed;
+    size_t error_offset;
+};
+
+struct bulk_worker {
+    struct bulk_job *job;
+    size_t index;
+    hashids_ctx_t ctx;
+    unsigned long long *numbers;    /* parse/byte-swap scratch */
+    size_t *offsets;
+    size_t *lengths;
+};
+
+static double
+bulk_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* IDs in a chunk can be at most this many */
+static size_t
+bulk_chunk_capacity(const struct bulk_job *job)
+{
+    return job->binary ? BULK_BINARY_CHUNK : BULK_TEXT_CHUNK / 2 + 1;
+}
+
+/* record the first input error */
+static void
+bulk_fail(struct bulk_job *job, size_t offset)
+{
+    int expected = 0;
+
+    if (atomic_compare_exchange_strong(&job->failed, &expected, 1)) {
+        job->error_offset = offset;
+    }
+}
+
+/* parse the decimal lines of a text chunk */
+static size_t
+bulk_parse_text(struct bulk_job *job, struct bulk_worker *worker,
+    size_t begin, size_t end)
+{
+    const char *p, *line_end, *stop;
+    unsigned long long number;
+    size_t count;
+    unsigned digit;
+
+    count = 0;
+    stop = job->input + end;
+    for (p = job->input + begin; p < stop; p = line_end + 1) {
+        line_end = memchr(p, '\n', stop - p);
+        if (!line_end) {
+            line_end = stop;
+        }
+
+        /* tolerate CRLF */
+        number = 0;
+        if (p == line_end || (line_end - p == 1 && *p == '\r')) {
+            bulk_fail(job, p - job->input);
+            return 0;
+        }
+        for (; p < line_end && *p != '\r'; ++p) {
+            digit = (unsigned)(*p - '0');
+            if (digit > 9 || number > (~0ull - digit) / 10) {
+                bulk_fail(job, p - job->input);
+                return 0;
+            }
+            number = number * 10 + digit;
+        }
+        if (p != line_end && p + 1 != line_end) {
+            bulk_fail(job, p - job->input);
+            return 0;
+        }
+
+        worker->numbers[count++] = number;
+    }
+
+    return count;
+}
+
+/* encode one chunk into its output slot */
+static void
+bulk_encode_chunk(struct bulk_job *job, struct bulk_worker *worker,
+    size_t chunk)
+{
+    const unsigned long long *numbers;
+    const unsigned char *bytes;
+    struct bulk_output *output;
+    size_t i, k, count, encoded;
+    unsigned long long number;
+    static const union { unsigned short s; unsigned char c; } endian = { 1 };
+
+    /* gather the numbers */
+    if (job->binary) {
+        i = chunk * BULK_BINARY_CHUNK;
+        count = job->input_size / 8 - i;
+        if (count > BULK_BINARY_CHUNK) {
+            count = BULK_BINARY_CHUNK;
+        }
+
+        if (endian.c) {
+            /* mmap is page aligned, so the u64s are too */
+            numbers = (const unsigned long long *)(const void *)
+                (job->input + i * 8);
+        } else {
+            bytes = (const unsigned char *)job->input + i * 8;
+            for (i = 0; i < count; ++i, bytes += 8) {
+                for (k = 8, number = 0; k--; ) {
+                    number = number << 8 | bytes[k];
+                }
+                worker->numbers[i] = number;
+            }
+            numbers = worker->numbers;
+        }
+    } else {
+        count = bulk_parse_text(job, worker, job->text_bounds[chunk],
+            job->text_bounds[chunk + 1]);
+        numbers = worker->numbers;
+    }
+
+    /* encode; every hash ends in a NUL that becomes its newline */
+    output = &job->outputs[chunk - job->round_first];
+    if (output->capacity < count * job->bound) {
+        free(output->buffer);
+        output->capacity = count * job->bound;
+        output->buffer = malloc(output->capacity);
+        if (!output->buffer) {
+            output->capacity = 0;
+            bulk_fail(job, 0);
+            return;
+        }
+    }
+    encoded = hashids_encode_batch(job->hashids, &worker->ctx,
+        output->buffer, output->capacity, count, NULL, numbers,
+        worker->offsets, worker->lengths);
+    if (encoded != count) {
+        bulk_fail(job, 0);
+        return;
+    }
+    for (i = 0; i < count; ++i) {
+        output->buffer[worker->offsets[i] + worker->lengths[i]] = '\n';
+    }
+    output->length = count ? worker->offsets[count - 1]
+        + worker->lengths[count - 1] + 1 : 0;
+    output->count = count;
+}
+
+/* claim chunks: own range first, then steal */
+static void
+bulk_work(struct bulk_worker *worker)
+{
+    struct bulk_job *job;
+    struct bulk_range *range;
+    size_t v, chunk;
+
+    job = worker->job;
+    for (v = 0; v < job->threads_count; ++v) {
+        range = &job->ranges[(worker->index + v) % job->threads_count];
+        while ((chunk = atomic_fetch_add(&range->next, 1)) < range->end) {
+            if (atomic_load(&job->failed)) {
+                return;
+            }
+            bulk_encode_chunk(job, worker, chunk);
+        }
+    }
+}
+
+static void *
+bulk_thread(void *arg)
+{
+    struct bulk_worker *worker;
+    struct bulk_job *job;
+    unsigned long seen;
+
+    worker = (struct bulk_worker *)arg;
+    job = worker->job;
+    seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->generation == seen && !job->quit) {
+            pthread_cond_wait(&job->start, &job->lock);
+        }
+        if (job->quit) {
+            pthread_mutex_unlock(&job->lock);
+            return NULL;
+        }
+        seen = job->generation;
+        pthread_mutex_unlock(&job->lock);
+
+        bulk_work(worker);
+
+        pthread_mutex_lock(&job->lock);
+        if (--job->active == 0) {
+            pthread_cond_signal(&job->done);
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+/* split a round's chunks into one contiguous range per worker and go */
+static void
+bulk_start_round(struct bulk_job *job, size_t first, size_t count,
+    struct bulk_output *outputs)
+{
+    size_t t, share, begin;
+
+    job->round_first = first;
+    job->round_count = count;
+    job->outputs = outputs;
+
+    for (t = 0, begin = first; t < job->threads_count; ++t) {
+        share = count / job->threads_count + (t < count % job->threads_count);
+        atomic_store(&job->ranges[t].next, begin);
+        job->ranges[t].end = begin + share;
+        begin += share;
+    }
+
+    pthread_mutex_lock(&job->lock);
+    job->active = job->threads_count;
+    ++job->generation;
+    pthread_cond_broadcast(&job->start);
+    pthread_mutex_unlock(&job->lock);
+}
+
+static void
+bulk_wait_round(struct bulk_job *job)
+{
+    pthread_mutex_lock(&job->lock);
+    while (job->active) {
+        pthread_cond_wait(&job->done, &job->lock);
+    }
+    pthread_mutex_unlock(&job->lock);
+}
+
+/* split text input into ~BULK_TEXT_CHUNK pieces of whole lines */
+static size_t *
+bulk_text_bounds(const char *input, size_t size, size_t *chunks_count)
+{
+    size_t *bounds, count, offset, next;
+    const char *newline;
+
+    bounds = malloc((size / BULK_TEXT_CHUNK + 2) * sizeof(*bounds));
+    if (!bounds) {
+        return NULL;
+    }
+
+    bounds[0] = 0;
+    for (count = 0, offset = 0; offset < size; offset = next) {
+        next = offset + BULK_TEXT_CHUNK;
+        if (next >= size) {
+            next = size;
+        } else {
+            /* extend to the end of the line */
+            newline = memchr(input + next - 1, '\n', size - next + 1);
+            next = newline ? (size_t)(newline - input) + 1 : size;
+        }
+        bounds[++count] = next;
+    }
+
+    *chunks_count = count;
+    return bounds;
+}
+
+static int
+bulk_usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-b] [-s salt] [-m min_length] [-a alphabet] "
+        "[-j threads] [-c cache_depth] [-p padding_depth] [-o output] "
+        "input\n", name);
+    return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bulk_job job;
+    struct bulk_worker *workers;
+    struct bulk_output *slots[2];
+    pthread_t *threads;
+    const char *salt, *alphabet, *output_path;
+    size_t min_length, cache_depth, padding_depth, round_size, first, count,
+        previous_first, previous_count, ids, bytes, i, t;
+    unsigned long long max;
+    hashids_t *hashids;
+    struct stat st;
+    FILE *out;
+    double start, elapsed;
+    int ch, fd, status;
+    long cpus;
+
+    memset(&job, 0, sizeof(job));
+    salt = BULK_APP_SALT;
+    alphabet = BULK_APP_ALPHABET;
+    min_length = BULK_APP_MIN_LENGTH;
+    output_path = NULL;
+    cache_depth = 0;
+    padding_depth = 0;
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    job.threads_count = cpus > 0 ? (size_t)cpus : 1;
+
+    while ((ch = getopt(argc, argv, "bs:m:a:j:c:p:o:")) != -1) {
+        switch (ch) {
+            case 'b':
+                job.binary = 1;
+                break;
+            case 's':
+                salt = optarg;
+                break;
+            case 'm':
+                min_length = strtoul(optarg, NULL, 10);
+                break;
+            case 'a':
+                alphabet = optarg;
+                break;
+            case 'j':
+                job.threads_count = strtoul(optarg, NULL, 10);
+                break;
+            case 'c':
+                cache_depth = strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                padding_depth = strtoul(optarg, NULL, 10);
+                break;
+            case 'o':
+                output_path = optarg;
+                break;
+            default:
+                return bulk_usage(argv[0]);
+        }
+    }
+    if (optind + 1 != argc || !job.threads_count) {
+        return bulk_usage(argv[0]);
+    }
+
+    /* the codec, shared read-only by all workers */
+    hashids = hashids_init3(salt, min_length, alphabet);
+    if (!hashids) {
+        fprintf(stderr, "hashids_init3: error %d\n", hashids_errno);
+        return 1;
+    }
+    if (cache_depth && hashids_cache_shuffles(hashids, cache_depth)) {
+        fprintf(stderr, "hashids_cache_shuffles: error %d\n", hashids_errno);
+        return 1;
+    }
+    if (padding_depth && hashids_cache_padding(hashids, padding_depth)) {
+        fprintf(stderr, "hashids_cache_padding: error %d\n", hashids_errno);
+        return 1;
+    }
+    max = ~0ull;
+    job.hashids = hashids;
+    job.bound = hashids_estimate_encoded_size(hashids, 1, &max);
+
+    /* map the input */
+    fd = open(argv[optind], O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    job.input_size = (size_t)st.st_size;
+    job.input = "";
+    if (job.input_size) {
+        job.input = mmap(NULL, job.input_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (job.input == MAP_FAILED) {
+            fprintf(stderr, "mmap: %s\n", strerror(errno));
+            return 1;
+        }
+#ifdef POSIX_MADV_SEQUENTIAL
+        posix_madvise((void *)job.input, job.input_size,
+            POSIX_MADV_SEQUENTIAL);
+#endif
+    }
+
+    if (job.binary) {
+        if (job.input_size % 8) {
+            fprintf(stderr, "%s: size is not a multiple of 8\n",
+                argv[optind]);
+            return 1;
+        }
+        job.chunks_count = (job.input_size / 8 + BULK_BINARY_CHUNK - 1)
+            / BULK_BINARY_CHUNK;
+    } else {
+        job.text_bounds = bulk_text_bounds(job.input, job.input_size,
+            &job.chunks_count);
+        if (!job.text_bounds) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    out = output_path ? fopen(output_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "%s: %s\n", output_path, strerror(errno));
+        return 1;
+    }
+
+    /* pool */
+    round_size = job.threads_count * BULK_ROUND_FACTOR;
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.start, NULL);
+    pthread_cond_init(&job.done, NULL);
+    job.ranges = calloc(job.threads_count, sizeof(*job.ranges));
+    slots[0] = calloc(round_size, sizeof(**slots));
+    slots[1] = calloc(round_size, sizeof(**slots));
+    workers = calloc(job.threads_count, sizeof(*workers));
+    threads = calloc(job.threads_count, sizeof(*threads));
+    if (!job.ranges || !slots[0] || !slots[1] || !workers || !threads) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (t = 0; t < job.threads_count; ++t) {
+        workers[t].job = &job;
+        workers[t].index = t;
+        workers[t].numbers = malloc(bulk_chunk_capacity(&job)
+            * sizeof(*workers[t].numbers));
+        workers[t].offsets = malloc(bulk_chunk_capacity(&job)
+            * sizeof(size_t));
+        workers[t].lengths = malloc(bulk_chunk_capacity(&job)
+            * sizeof(size_t));
+        if (!workers[t].numbers || !workers[t].offsets
+            || !workers[t].lengths
+            || pthread_create(&threads[t], NULL, bulk_thread, &workers[t])) {
+            fprintf(stderr, "cannot start worker %zu\n", t);
+            return 1;
+        }
+    }
+
+    /* encode round r while writing round r - 1 */
+    start = bulk_now();
+    status = 0;
+    ids = 0;
+    bytes = 0;
+    previous_first = 0;
+    previous_count = 0;
+    for (first = 0; ; first += count) {
+        count = job.chunks_count - first;
+        if (count > round_size) {
+            count = round_size;
+        }
+        if (count) {
+            bulk_start_round(&job, first, count, slots[(first / round_size)
+                % 2]);
+        }
+
+        for (i = 0; i < previous_count; ++i) {
+            struct bulk_output *output =
+                &slots[(previous_first / round_size) % 2][i];
+
+            if (fwrite(output->buffer, 1, output->length, out)
+                != output->length) {
+                fprintf(stderr, "write: %s\n", strerror(errno));
+                status = 1;
+            }
+            bytes += output->length;
+            ids += output->count;
+        }
+
+        if (!count) {
+            break;
+        }
+        bulk_wait_round(&job);
+        if (atomic_load(&job.failed)) {
+            break;
+        }
+        previous_first = first;
+        previous_count = count;
+    }
+    if (fflush(out)) {
+        fprintf(stderr, "write: %s\n", strerror(errno));
+        status = 1;
+    }
+    elapsed = bulk_now() - start;
+
+    /* shut the pool down */
+    pthread_mutex_lock(&job.lock);
+    job.quit = 1;
+    pthread_cond_broadcast(&job.start);
+    pthread_mutex_unlock(&job.lock);
+    for (t = 0; t < job.threads_count; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    if (atomic_load(&job.failed)) {
+        fprintf(stderr, "%s: invalid input near byte %zu\n", argv[optind],
+            job.error_offset);
+        return 1;
+    }
+
+    /* throughput */
+    fprintf(stderr, "%zu ids (%zu bytes) in %.3f s with %zu threads: "
+        "%.0f ids/s, %.1f MB/s\n", ids, bytes, elapsed, job.threads_count,
+        elapsed > 0 ? ids / elapsed : 0.0,
+        elapsed > 0 ? bytes / elapsed / 1e6 : 0.0);
+
+    hashids_free(hashids);
+    return status;
+}